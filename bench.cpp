@@ -0,0 +1,400 @@
+#include "slicer.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define BENCH_RUSAGE 1
+#else
+#define BENCH_RUSAGE 0
+#endif
+
+/*
+
+    SLICER BENCHMARKS
+
+    Usage:
+
+        g++ -O2 -pthread bench.cpp -o bench
+        g++ -O2 -pthread -fopenmp bench.cpp -o bench    (with an offloading compiler, cut_offload runs on the GPU)
+        ./bench [--sizes 10000,100000,1000000] [--shapes torus,sphere,terrain] [--threads N] [--dir /tmp] > report.json
+
+    Each synthetic mesh is generated in memory, then every operation is timed separately on a fresh copy.
+    The report is a JSON array with one record per shape, size and operation.
+
+*/
+
+
+
+//
+// Allocation counting, through replacements of the global operator new and delete.
+// GCC warns about free on inlined operator new results, which is what these replacements do on purpose.
+//
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+
+
+//
+// Peak resident set size of the process so far, in bytes (0 if unknown).
+//
+static size_t peak_rss()
+{
+    #if BENCH_RUSAGE
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);
+    #else
+    return size_t(usage.ru_maxrss) * 1024;
+    #endif
+    #else
+    return 0;
+    #endif
+}
+
+
+
+//
+// Synthetic mesh generators. Each one makes a closed or open mesh with about the given number of triangles.
+//
+struct Generator
+{
+    // Torus with major radius 1 and minor radius 0.3, as a grid of nu*nv quads.
+    static void torus(Slicer& mesh, size_t triangles)
+    {
+        size_t nu = std::max<size_t>(3, size_t(std::sqrt(triangles / 2.0)));
+        size_t nv = std::max<size_t>(3, triangles / (2*nu));
+        mesh.clear();
+        for (size_t u = 0 ; u < nu ; u++)
+        {
+            for (size_t v = 0 ; v < nv ; v++)
+            {
+                const double pi = 3.14159265358979323846;
+                double a = 2*pi*u / nu, b = 2*pi*v / nv;
+                mesh.positions.push_back({{ (1 + 0.3*std::cos(b)) * std::cos(a), 0.3*std::sin(b), (1 + 0.3*std::cos(b)) * std::sin(a) }});
+            }
+        }
+        for (size_t u = 0 ; u < nu ; u++)
+        {
+            for (size_t v = 0 ; v < nv ; v++)
+            {
+                int i = int(u*nv + v), j = int(((u+1) % nu)*nv + v);
+                int k = int(u*nv + (v+1) % nv), l = int(((u+1) % nu)*nv + (v+1) % nv);
+                mesh.triangles.push_back({{ i, k, j }});
+                mesh.triangles.push_back({{ j, k, l }});
+            }
+        }
+    }
+
+    // Unit sphere, made by subdividing an icosahedron until it has at least the given number of triangles.
+    static void sphere(Slicer& mesh, size_t triangles)
+    {
+        const double t = (1 + std::sqrt(5.0)) / 2;
+        mesh.clear();
+        mesh.positions =
+        {
+            {{ -1,  t,  0 }}, {{  1,  t,  0 }}, {{ -1, -t,  0 }}, {{  1, -t,  0 }},
+            {{  0, -1,  t }}, {{  0,  1,  t }}, {{  0, -1, -t }}, {{  0,  1, -t }},
+            {{  t,  0, -1 }}, {{  t,  0,  1 }}, {{ -t,  0, -1 }}, {{ -t,  0,  1 }}
+        };
+        mesh.triangles =
+        {
+            {{ 0, 11, 5 }}, {{ 0, 5, 1 }},  {{ 0, 1, 7 }},   {{ 0, 7, 10 }}, {{ 0, 10, 11 }},
+            {{ 1, 5, 9 }},  {{ 5, 11, 4 }}, {{ 11, 10, 2 }}, {{ 10, 7, 6 }}, {{ 7, 1, 8 }},
+            {{ 3, 9, 4 }},  {{ 3, 4, 2 }},  {{ 3, 2, 6 }},   {{ 3, 6, 8 }},  {{ 3, 8, 9 }},
+            {{ 4, 9, 5 }},  {{ 2, 4, 11 }}, {{ 6, 2, 10 }},  {{ 8, 6, 7 }},  {{ 9, 8, 1 }}
+        };
+
+        // Split each triangle into four, sharing the midpoints of edges.
+        while (mesh.triangles.size() < triangles)
+        {
+            std::vector<Slicer::Triangle> faces;
+            faces.reserve(4 * mesh.triangles.size());
+            std::vector<std::vector<std::pair<int, int>>> midpoints(mesh.positions.size());
+            auto midpoint = [&](int i, int j)
+            {
+                if (i > j) std::swap(i, j);
+                for (const std::pair<int, int>& m : midpoints[i]) if (m.first == j) return m.second;
+                const Slicer::Vector& p = mesh.positions[i];
+                const Slicer::Vector& q = mesh.positions[j];
+                int m = int(mesh.positions.size());
+                mesh.positions.push_back({{ (p[0] + q[0]) / 2, (p[1] + q[1]) / 2, (p[2] + q[2]) / 2 }});
+                midpoints[i].push_back(std::make_pair(j, m));
+                return m;
+            };
+            for (const Slicer::Triangle& f : mesh.triangles)
+            {
+                int a = midpoint(f[0], f[1]), b = midpoint(f[1], f[2]), c = midpoint(f[2], f[0]);
+                faces.push_back({{ f[0], a, c }});
+                faces.push_back({{ f[1], b, a }});
+                faces.push_back({{ f[2], c, b }});
+                faces.push_back({{ a, b, c }});
+            }
+            mesh.triangles.swap(faces);
+        }
+
+        // Project vertices on the unit sphere.
+        for (Slicer::Vector& p : mesh.positions)
+        {
+            double length = std::sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+            for (double& c : p) c /= length;
+        }
+    }
+
+    // Height field over [-1, 1]^2 with a few octaves of deterministic noise (open mesh).
+    static void terrain(Slicer& mesh, size_t triangles)
+    {
+        size_t n = std::max<size_t>(2, size_t(std::sqrt(triangles / 2.0)));
+        mesh.clear();
+        for (size_t y = 0 ; y <= n ; y++)
+        {
+            for (size_t x = 0 ; x <= n ; x++)
+            {
+                double u = 2.0*x / n - 1, v = 2.0*y / n - 1;
+                double h = 0.2*std::sin(3*u) * std::cos(2*v) + 0.05*std::sin(17*u + 11*v) + 0.01*noise(x, y);
+                mesh.positions.push_back({{ u, h, v }});
+            }
+        }
+        for (size_t y = 0 ; y < n ; y++)
+        {
+            for (size_t x = 0 ; x < n ; x++)
+            {
+                int i = int(y*(n+1) + x), j = i + 1, k = i + int(n+1), l = k + 1;
+                mesh.triangles.push_back({{ i, k, j }});
+                mesh.triangles.push_back({{ j, k, l }});
+            }
+        }
+    }
+
+    // Hash of grid coordinates to [-1, 1].
+    static double noise(size_t x, size_t y)
+    {
+        uint64_t k = uint64_t(x) * 0x9e3779b97f4a7c15ULL ^ uint64_t(y) * 0xc2b2ae3d27d4eb4fULL;
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return double(k >> 11) / double(1ull << 52) - 1;
+    }
+};
+
+
+
+//
+// Timing of one operation, written as a JSON record.
+//
+struct Report
+{
+    std::string text;
+
+    void add(const std::string& shape, size_t triangles, const std::string& operation, double seconds, size_t allocated, size_t rss)
+    {
+        char line[512];
+        std::snprintf(line, sizeof(line),
+            "%s\n  { \"shape\": \"%s\", \"triangles\": %zu, \"operation\": \"%s\", \"seconds\": %.6f, "
+            "\"triangles_per_second\": %.0f, \"allocations\": %zu, \"peak_rss\": %zu }",
+            text.empty() ? "" : ",", shape.c_str(), triangles, operation.c_str(), seconds,
+            seconds > 0 ? triangles / seconds : 0.0, allocated, rss);
+        text += line;
+    }
+};
+
+//
+// Run setup (untimed), then operation, and add its timing to report.
+//
+static void measure(Report& report, const std::string& shape, size_t triangles, const std::string& operation,
+                    const std::function<void()>& setup, const std::function<void()>& function)
+{
+    setup();
+    size_t allocated = allocations;
+    auto start = std::chrono::steady_clock::now();
+    function();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.add(shape, triangles, operation, seconds, allocations - allocated, peak_rss());
+    std::cerr << shape << " " << triangles << " " << operation << ": " << seconds << " s" << std::endl;
+}
+
+//
+// Split a comma-separated list.
+//
+static std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> sizes  = { "10000", "100000", "1000000" };
+    std::vector<std::string> shapes = { "torus", "sphere", "terrain" };
+    unsigned threads = 0;
+    std::string dir = ".";
+    for (int a = 1 ; a < argc ; a++)
+    {
+        std::string arg = argv[a];
+        if      (arg == "--sizes"   && a+1 < argc) sizes   = split_list(argv[++a]);
+        else if (arg == "--shapes"  && a+1 < argc) shapes  = split_list(argv[++a]);
+        else if (arg == "--threads" && a+1 < argc) threads = std::atoi(argv[++a]);
+        else if (arg == "--dir"     && a+1 < argc) dir     = argv[++a];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--sizes 10000,100000,1000000] [--shapes torus,sphere,terrain] [--threads N] [--dir DIR]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::string obj   = dir + "/bench_input.obj";
+    const std::string mmsb  = dir + "/bench_input.mmsb";
+    const std::string out   = dir + "/bench_output.obj";
+    const std::string above = dir + "/bench_above.obj";
+    const std::string below = dir + "/bench_below.obj";
+
+    // Slightly tilted plane through the middle of the meshes, and a stack of parallel planes.
+    const Slicer::Vector origin = {{ 0.01, 0.02, 0.03 }};
+    const Slicer::Vector normal = {{ 0.1, 1, 0.2 }};
+
+    Report report;
+    for (const std::string& shape : shapes)
+    {
+        for (const std::string& size : sizes)
+        {
+            Slicer base;
+            if      (shape == "torus")   Generator::torus(base, std::strtoull(size.c_str(), nullptr, 10));
+            else if (shape == "sphere")  Generator::sphere(base, std::strtoull(size.c_str(), nullptr, 10));
+            else if (shape == "terrain") Generator::terrain(base, std::strtoull(size.c_str(), nullptr, 10));
+            else
+            {
+                std::cerr << "Unknown shape " << shape << std::endl;
+                return EXIT_FAILURE;
+            }
+            base.origin = origin;
+            base.normal = normal;
+            size_t n = base.triangles.size();
+
+            Slicer slicer;
+            auto fresh = [&]() { slicer = base; };
+            auto none  = []() {};
+            auto record = [&](const std::string& operation, const std::function<void()>& setup, const std::function<void()>& function)
+            {
+                measure(report, shape, n, operation, setup, function);
+            };
+
+            // File formats.
+            record("save",          fresh, [&]() { slicer.save(obj); });
+            record("save_binary",   fresh, [&]() { slicer.save_binary(mmsb); });
+            record("load",          none,  [&]() { slicer.load(obj); });
+            record("load_mmap",     none,  [&]() { slicer.load_mmap(obj); });
+            record("load_parallel", none,  [&]() { slicer.load_parallel(obj, threads); });
+            record("load_binary",   none,  [&]() { slicer.load_binary(mmsb); });
+
+            // Cuts.
+            record("cut",           fresh, [&]() { slicer.cut(); });
+            record(Slicer::offload_devices() ? "cut_offload" : "cut_offload_cpu", [&]() { fresh(); slicer.offload = true; }, [&]() { slicer.cut(); });
+            record("cut_soa",       [&]() { fresh(); slicer.soa = true; }, [&]() { slicer.cut(); });
+            record("cut_float",     [&]() { fresh(); slicer.soa = slicer.float_classify = true; }, [&]() { slicer.cut(); });
+            record("cut_axis",      [&]() { fresh(); slicer.normal = {{ 0, 1, 0 }}; }, [&]() { slicer.cut(); });
+            record("cut_parallel",  fresh, [&]() { slicer.cut_parallel(threads); });
+            record("cut_edges",     [&]() { fresh(); slicer.edge_indexed = true; }, [&]() { slicer.cut(); });
+            record("cut_batch",     [&]() { fresh(); slicer.set_planes({{ 0, -0.5, 0 }}, normal, 0.1, 10); }, [&]() { slicer.cut_batch(); });
+            record("save_cut",      none,  [&]() { slicer.save(out); });
+
+            // Cuts of the mesh with its vertices and faces shuffled (like scanner output), then reordered.
+            auto shuffled = [&]()
+            {
+                fresh();
+                std::mt19937 random(1);
+                std::vector<int> renumber(slicer.positions.size());
+                for (size_t v = 0 ; v < renumber.size() ; v++) renumber[v] = int(v);
+                std::shuffle(renumber.begin(), renumber.end(), random);
+                std::vector<Slicer::Vector> positions(slicer.positions.size());
+                for (size_t v = 0 ; v < renumber.size() ; v++) positions[renumber[v]] = slicer.positions[v];
+                slicer.positions.swap(positions);
+                for (Slicer::Triangle& t : slicer.triangles) for (int& v : t) v = renumber[v];
+                std::shuffle(slicer.triangles.begin(), slicer.triangles.end(), random);
+            };
+            record("cut_shuffled",  shuffled, [&]() { slicer.cut(); });
+            record("reorder",       shuffled, [&]() { slicer.reorder(); });
+            record("cut_reordered", [&]() { shuffled(); slicer.reorder(); }, [&]() { slicer.cut(); });
+
+            // Repeated cuts with the bounding volume hierarchy (built by the first one).
+            record("cut_indexed_x10", [&]() { fresh(); slicer.indexed = true; }, [&]()
+            {
+                for (int k = 0 ; k < 10 ; k++)
+                {
+                    slicer.origin = {{ 0, -0.5 + 0.1*k, 0 }};
+                    slicer.cut();
+                }
+            });
+
+            // Sweep of 100 small steps, with delta cuts of the indexed mesh, and with incremental recuts
+            // (after sorting the vertices with a first recut).
+            Slicer::Delta delta;
+            Slicer::Sweep sweep;
+            auto step = [&](int k) { return Slicer::Plane{ {{ 0, -0.1 + 0.002*k, 0 }}, normal }; };
+            record("sweep_delta_x100", [&]() { fresh(); slicer.build_index(); }, [&]()
+            {
+                for (int k = 1 ; k <= 100 ; k++) slicer.cut(step(k), delta);
+            });
+            record("sweep_recut_x100", [&]() { fresh(); sweep = Slicer::Sweep(); slicer.recut(step(0), sweep); }, [&]()
+            {
+                for (int k = 1 ; k <= 100 ; k++) slicer.recut(step(k), sweep);
+            });
+
+            // Modes that don't modify the mesh in memory.
+            record("contours",      fresh, [&]() { std::vector<Slicer::Contour> contours; slicer.contours(contours); });
+            record("contours_stream", fresh, [&]() { std::vector<Slicer::Contour> contours; slicer.contours_stream(obj, contours); });
+            record("cut_stream",    fresh, [&]() { slicer.cut_stream(obj, out); });
+            record("cut_pipelined", fresh, [&]() { slicer.cut_pipelined(obj, out); });
+            record("save_halves",   [&]() { fresh(); slicer.cut(); }, [&]() { slicer.save_halves(above, below); });
+        }
+    }
+
+    std::cout << "[" << report.text << "\n]" << std::endl;
+
+    for (const std::string& file : { obj, mmsb, out, above, below }) std::remove(file.c_str());
+    return EXIT_SUCCESS;
+}
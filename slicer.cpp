@@ -1,279 +1,608 @@
-#include <iostream>
-#include <fstream>
-#include <cmath>
-#include <regex>
+#include "slicer.h"
 
-/*
+#include <mutex>
 
-    MINIMALISTIC MESH SLICER
 
-    Quick usage:
 
-        Slicer slicer;
-        slicer.load("torus.obj");
-        slicer.read_json("plane.json");
-        slicer.cut();
-        slicer.save("output.obj");
+//
+// Command-line options.
+//
+struct Options
+{
+    std::vector<std::string> files;
+    bool mmap_load = false;
+    unsigned threads = 1;
+    bool soa = false, float_classify = false, contour = false, stream = false, halves = false, robust = false, reorder = false;
+    bool offload = false;
+    bool stats = false, stats_json = false;
+    bool serve = false, batch = false;
+};
 
-    There is only minimal error and edge-case handling.
-    See README.md for more details.
 
-*/
 
-class Slicer
+//
+// Phase timings and counters printed with --stats.
+//
+struct Report
 {
+    std::vector<std::pair<std::string, double>> phases;
+    std::vector<std::pair<std::string, double>> counters;
+    std::chrono::steady_clock::time_point       start = std::chrono::steady_clock::now();
 
-public:
-
-    // Vertex and face data.
-    using Vector            = std::array<double, 3>;
-    using Triangle          = std::array<int, 3>;
-    std::vector<Vector>     positions;
-    std::vector<Triangle>   triangles;
-
-    // Cutting plane used for slicing.
-    Vector origin;
-    Vector normal;
+    // End the current phase, which started at the end of the previous one.
+    void phase(const std::string& name)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        phases.push_back(std::make_pair(name, std::chrono::duration<double>(now - start).count()));
+        start = now;
+    }
 
+    void count(const std::string& name, double value)
+    {
+        counters.push_back(std::make_pair(name, value));
+    }
 
+    // Add the phases and counters of the last cut.
+    template<typename Stats>
+    void cut(const Stats& stats)
+    {
+        phases.push_back(std::make_pair("cut.classify", stats.classify_seconds));
+        phases.push_back(std::make_pair("cut.split",    stats.split_seconds));
+        count("crossing_triangles",   double(stats.crossing));
+        count("splits",               double(stats.splits));
+        count("splits_per_crossing",  stats.crossing ? double(stats.splits) / stats.crossing : 0.0);
+        count("retries",              double(stats.retries));
+        count("retries_per_crossing", stats.crossing ? double(stats.retries) / stats.crossing : 0.0);
+        count("intersection_hits",    double(stats.hits));
+        count("intersection_misses",  double(stats.misses));
+        count("snapped_vertices",     double(stats.snapped));
+    }
 
-    //
-    // Clear mesh.
-    //
-    void clear()
+    void print(bool json) const
     {
-        positions.clear();
-        triangles.clear();
+        if (json)
+        {
+            std::printf("{ \"phases\": {");
+            for (size_t p = 0 ; p < phases.size() ; p++) std::printf("%s\"%s\": %.9g", p ? ", " : " ", phases[p].first.c_str(), phases[p].second);
+            std::printf(" }, \"counters\": {");
+            for (size_t c = 0 ; c < counters.size() ; c++) std::printf("%s\"%s\": %.15g", c ? ", " : " ", counters[c].first.c_str(), counters[c].second);
+            std::printf(" } }\n");
+            std::fflush(stdout);
+            return;
+        }
+        std::printf("Stats:\n");
+        for (const std::pair<std::string, double>& p : phases)
+        {
+            std::printf("    %-24s %.6f s\n", p.first.c_str(), p.second);
+        }
+        for (const std::pair<std::string, double>& c : counters)
+        {
+            std::printf("    %-24s %.15g\n", c.first.c_str(), c.second);
+        }
+        std::fflush(stdout);
     }
+};
 
+//
+// Size of a file in bytes, or 0 if it can't be opened.
+//
+static double file_size(const std::string& filename)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) return 0;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fclose(file);
+    return size > 0 ? double(size) : 0;
+}
+
+//
+// Tell if options change the cut in ways that the const delta cut of a .mmsd output ignores:
+// it classifies on the CPU without SIMD or single precision, doesn't snap, and saves a single file.
+//
+static bool delta_ignores(const Options& options)
+{
+    return options.soa || options.float_classify || options.robust || options.offload || options.halves || options.stream;
+}
 
+//
+// Names of the files saved by --split for output: output_above.obj and output_below.obj (with the extension of output).
+//
+static void split_names(const std::string& output, std::string& above, std::string& below)
+{
+    size_t dot = output.rfind('.');
+    if (dot == std::string::npos || output.find('/', dot) != std::string::npos) dot = output.size();
+    above = output.substr(0, dot) + "_above" + output.substr(dot);
+    below = output.substr(0, dot) + "_below" + output.substr(dot);
+}
 
-    //
-    // Load OBJ file.
-    //
-    bool load(std::string filename)
-    {
-        clear();
 
-        // Open the file.
-        std::ifstream file(filename);
-        if (!file) return false;
 
-        // Read file line by line.
+//
+// Serve cut requests read from standard input, one per line, on a loaded mesh.
+//
+// A request is "ox oy oz nx ny nz output.obj": the mesh cut by the plane with this origin and normal
+// is saved to output.obj, and "ok output.obj <vertices> <triangles>" is printed. Invalid requests
+// and failed saves print "error <request>". The server stops at the end of the input or on "quit".
+//
+// Each thread cuts the shared mesh into its own delta, so requests are served concurrently
+// and answers can come in a different order than the requests.
+//
+template<typename Mesh>
+int serve(const Mesh& slicer, unsigned threads)
+{
+    std::mutex input, output;
+    bool done = false;
+    auto worker = [&]()
+    {
+        typename Mesh::Delta delta;
         std::string line;
-        while (std::getline(file, line))
+        for (;;)
         {
-            // Read first word in line.
-            std::istringstream iss(line);
-            std::string prefix;
-            iss >> prefix;
-
-            // If vertex.
-            if (prefix == "v")
             {
-                Vector p;
-                iss >> p[0] >> p[1] >> p[2];
-                positions.push_back(p);
-            }
-            
-            // If triangle.
-            else if (prefix == "f")
-            {
-                Triangle t;
-                iss >> t[0] >> t[1] >> t[2];
-                for (int& i : t) i--;
-                triangles.push_back(t);
+                std::lock_guard<std::mutex> lock(input);
+                if (done || !std::getline(std::cin, line) || line == "quit") { done = true; return; }
             }
+            if (line.empty()) continue;
 
-            // If something else.
-            else
+            std::istringstream request(line);
+            std::array<double, 6> plane;
+            std::string filename;
+            bool valid = true;
+            for (double& x : plane) valid = valid && (request >> x);
+            valid = valid && (request >> filename);
+
+            bool saved = false;
+            if (valid)
             {
-                // We ignore the line if it's not a vertex or triangle.
+                typename Mesh::Plane cut;
+                for (int a = 0 ; a < 3 ; a++) { cut.origin[a] = plane[a]; cut.normal[a] = plane[3+a]; }
+                slicer.cut(cut, delta);
+                saved = slicer.save(filename, delta);
             }
+
+            std::lock_guard<std::mutex> lock(output);
+            if (saved) std::cout << "ok " << filename << " " << delta.base_vertices + delta.vertices.size()
+                                 << " " << delta.base_triangles + delta.appended.size() << std::endl;
+            else       std::cout << "error " << line << std::endl;
         }
+    };
 
-        return true;
-    }
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> pool;
+    for (unsigned w = 1 ; w < threads ; w++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+    return EXIT_SUCCESS;
+}
 
 
 
-    //
-    // Save OBJ file.
-    //
-    bool save(std::string filename)
+//
+// Run the jobs of a manifest file, one per line: "mesh.obj plane.json output.obj".
+//
+// Empty lines and lines starting with '#' are skipped. Each job loads the mesh, cuts it by the planes
+// of the JSON file and saves the result as for a single file: .mmsb files use the binary format,
+// .mmsd files only get the delta (and fail with the options it ignores, see delta_ignores),
+// and --contour and --split save the polylines or the two halves.
+// Then it prints "ok output.obj <vertices> <triangles>" (the numbers of points and polylines with --contour),
+// or "error <job>" if any step fails. A throughput summary is printed at the end.
+//
+// The jobs are split into one queue per thread. Each thread takes jobs from the front of its queue
+// and, once it is empty, steals them from the back of the others, so that threads that got
+// small meshes help the others. Each thread reuses its Slicer, and so its buffers, for all its jobs.
+//
+template<typename Mesh>
+int batch(const Options& options)
+{
+    // Read the manifest.
+    std::ifstream manifest(options.files[0]);
+    if (!manifest)
+    {
+        std::cerr << "Could not read file " << options.files[0] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> jobs;
+    std::string line;
+    while (std::getline(manifest, line))
     {
-        // Open the file.
-        std::ofstream file(filename);
-        if (!file) return false;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first != std::string::npos && line[first] != '#') jobs.push_back(line);
+    }
 
-        // Write vertices.
-        for (Vector p : positions)
+    // Deal out the jobs in contiguous blocks, so that threads steal from the end of each other's blocks.
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = unsigned(std::max<size_t>(1, std::min<size_t>(threads, jobs.size())));
+    struct Queue
+    {
+        std::mutex         mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<Queue> queues(threads);
+    for (size_t j = 0 ; j < jobs.size() ; j++) queues[j * threads / jobs.size()].jobs.push_back(j);
+
+    // Take the next job of thread w, or steal one. Jobs are never added, so there is none left once all queues are empty.
+    auto take = [&](unsigned w, size_t& job)
+    {
+        for (unsigned v = 0 ; v < threads ; v++)
         {
-            file << "v " << p[0] << " " << p[1] << " " << p[2] << std::endl;
+            Queue& queue = queues[(w + v) % threads];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) continue;
+            if (v == 0) { job = queue.jobs.front(); queue.jobs.pop_front(); }
+            else        { job = queue.jobs.back();  queue.jobs.pop_back();  }
+            return true;
         }
-
-        // Write triangles.
-        for (Triangle t : triangles)
+        return false;
+    };
+
+    // Totals, summed over threads when they finish.
+    // With --stats-json, job results and the summary go to the standard error, as in run.
+    std::ostream& log = options.stats_json ? std::cerr : std::cout;
+    std::mutex output;
+    size_t failed = 0, triangles = 0;
+    double read = 0, written = 0;
+    typename Mesh::Stats total;
+    Report report;
+    auto add = [](typename Mesh::Stats& sum, const typename Mesh::Stats& stats)
+    {
+        sum.classify_seconds += stats.classify_seconds;
+        sum.split_seconds    += stats.split_seconds;
+        sum.crossing         += stats.crossing;
+        sum.splits           += stats.splits;
+        sum.retries          += stats.retries;
+        sum.hits             += stats.hits;
+        sum.misses           += stats.misses;
+        sum.snapped          += stats.snapped;
+    };
+
+    auto worker = [&](unsigned w)
+    {
+        Mesh slicer;
+        slicer.soa = options.soa;
+        slicer.float_classify = options.float_classify;
+        slicer.robust = options.robust;
+        slicer.offload = options.offload;
+        typename Mesh::Stats stats, local_total;
+        if (options.stats) slicer.stats = &stats;
+
+        size_t job, local_failed = 0, local_triangles = 0;
+        double local_read = 0, local_written = 0;
+        while (take(w, job))
         {
-            for (int& i : t) i++;
-            file << "f " << t[0] << " " << t[1] << " " << t[2] << std::endl;
+            std::istringstream request(jobs[job]);
+            std::string mesh, plane, result;
+            bool ok = bool(request >> mesh >> plane >> result);
+
+            ok = ok && (Mesh::is_binary(mesh) ? slicer.load_binary(mesh)
+                      : options.mmap_load     ? slicer.load_mmap(mesh)
+                      :                         slicer.load(mesh));
+            if (ok && options.reorder) slicer.reorder();
+            ok = ok && slicer.read_json(plane);
+            if (ok) local_triangles += slicer.triangles.size();
+
+            // Save the output as run does, with the sizes printed in the answer.
+            std::vector<std::string> outputs(1, result);
+            size_t vertices = 0, faces = 0;
+            if (ok && options.contour)
+            {
+                std::vector<typename Mesh::Contour> contours;
+                slicer.contours(contours);
+                for (const typename Mesh::Contour& c : contours) { vertices += c.points.size(); faces += c.loops.size(); }
+                ok = slicer.save_contours(result, contours);
+            }
+            else if (ok && Mesh::is_delta(result))
+            {
+                typename Mesh::Delta delta;
+                ok = slicer.planes.size() == 1 && !delta_ignores(options);
+                if (ok) slicer.cut({ slicer.origin, slicer.normal }, delta);
+                ok = ok && slicer.save_delta(result, delta);
+                vertices = delta.base_vertices  + delta.vertices.size();
+                faces    = delta.base_triangles + delta.appended.size();
+            }
+            else if (ok)
+            {
+                // A cut which returns early records nothing: start from zero so the previous job is not added twice.
+                stats = typename Mesh::Stats();
+                if (slicer.planes.size() > 1) slicer.cut_batch();
+                else                          slicer.cut();
+                add(local_total, stats);
+                if (options.halves)
+                {
+                    outputs.resize(2);
+                    split_names(result, outputs[0], outputs[1]);
+                    ok = slicer.planes.size() == 1 && slicer.save_halves(outputs[0], outputs[1]);
+                }
+                else ok = Mesh::is_binary(result) ? slicer.save_binary(result) : slicer.save(result);
+                vertices = slicer.positions.size();
+                faces    = slicer.triangles.size();
+            }
+
+            if (ok)
+            {
+                local_read += file_size(mesh) + file_size(plane);
+                for (const std::string& file : outputs) local_written += file_size(file);
+            }
+            else local_failed++;
+
+            std::lock_guard<std::mutex> lock(output);
+            if (ok) log << "ok " << result << " " << vertices << " " << faces << "\n";
+            else    log << "error " << jobs[job] << "\n";
         }
 
-        return true;
+        std::lock_guard<std::mutex> lock(output);
+        failed    += local_failed;
+        triangles += local_triangles;
+        read      += local_read;
+        written   += local_written;
+        add(total, local_total);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned w = 1 ; w < threads ; w++) pool.emplace_back(worker, w);
+    worker(0);
+    for (std::thread& t : pool) t.join();
+    report.phase("batch");
+    log << std::flush;
+
+    double seconds = std::max(report.phases.back().second, 1e-9);
+    std::fprintf(options.stats_json ? stderr : stdout, "Batch: %zu jobs (%zu failed) on %u threads in %.3f s: %.1f jobs/s, %.0f triangles/s, %.1f MB/s read\n",
+                jobs.size(), failed, threads, seconds, jobs.size() / seconds, triangles / seconds, read / seconds / 1e6);
+    std::fflush(options.stats_json ? stderr : stdout);
+    if (options.stats)
+    {
+        report.cut(total);
+        report.count("jobs",          double(jobs.size()));
+        report.count("failed_jobs",   double(failed));
+        report.count("bytes_read",    read);
+        report.count("bytes_written", written);
+        report.print(options.stats_json);
     }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
 
 
-    //
-    // Slice mesh by plane.
-    //
-    void cut()
-    {
-        // We loop on all triangle indices (tid) in the mesh.
-        // The do_triangle function is called on each tid,
-        // and will split the triangle when required.
-        //
-        // If do_triangle returns false, the triangle doesn't intersect the mesh.
-        // The mesh (and triangle) is unchanged and we go the next triangle (tid+=1).
-        //
-        // If do_triangle return true, the triangle intersects the mesh.
-        // The triangle has been modified and a new triangle has been appended to the mesh.
-        // Since the modified triangle might still require splitting, we stay on it (tid+=0).
-        // The new appended triangle will be processed at the end.
-        //
-        // See do_triangle.png for a picture.
-
-        intersections.clear();        
-        if (origin[0] == 0 && origin[1] == 0 && origin[2] == 0) return;
-        for (size_t tid = 0 ; tid < triangles.size() ; tid += !do_triangle(tid));
-    }
+//
+// Load, cut and save with the Slicer instantiation for the chosen scalar and index types.
+//
+template<typename Scalar, typename Index>
+int run(const Options& options)
+{
+    using Mesh = BasicSlicer<Scalar, Index>;
+    if (options.batch) return batch<Mesh>(options);
 
+    std::string output = options.files.size() > 2 ? options.files[2] : "output.obj";
 
+    // The delta cut is also single-threaded, and records no cut statistics.
+    if (!options.contour && Mesh::is_delta(output) && (delta_ignores(options) || options.threads != 1 || options.stats))
+    {
+        std::cerr << "A .mmsd output doesn't support --threads, --soa, --float, --robust, --offload, --split, --stream or --stats" << std::endl;
+        return EXIT_FAILURE;
+    }
 
-private:
+    // With --stats-json, progress messages go to the standard error, leaving only the JSON report on the standard output.
+    // With --serve, they go to the standard error too, leaving only the answers to requests.
+    std::ostream& log = options.stats_json || options.serve ? std::cerr : std::cout;
+    Mesh slicer;
+    slicer.soa = options.soa;
+    slicer.float_classify = options.float_classify;
+    slicer.robust = options.robust;
+    slicer.offload = options.offload;
+    if (options.offload && Mesh::offload_devices() == 0) log << "No offload device, cutting on the CPU" << std::endl;
+
+    // Phase timings, and cut statistics (which are only collected with --stats).
+    Report report;
+    typename Mesh::Stats stats;
+    if (options.stats) slicer.stats = &stats;
+    auto finish = [&](const std::vector<std::string>& written)
+    {
+        if (!options.stats) return EXIT_SUCCESS;
+        double read = 0, write = 0;
+        for (size_t f = 0 ; f < 2 ; f++) read += file_size(options.files[f]);
+        for (const std::string& file : written) write += file_size(file);
+        report.count("bytes_read", read);
+        report.count("bytes_written", write);
+        report.print(options.stats_json);
+        return EXIT_SUCCESS;
+    };
 
-    // Floating point arithmetic is non-exact which might
-    // cause problems when computing intersections.
-    // We fix that using a hardcoded precision value.
-    static constexpr double precision = 0.00001;
+    if (options.stream)
+    {
+        if (!slicer.read_json(options.files[1]))
+        {
+            std::cerr << "Could not read file " << options.files[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+        log << "File " << options.files[1] << " loaded" << std::endl;
+        report.phase("read_json");
 
-    // Keep track of indices of intersection points.
-    std::map<std::pair<int, int>, int> intersections;
+        if (options.contour)
+        {
+            std::vector<typename Mesh::Contour> contours;
+            if (!slicer.contours_stream(options.files[0], contours))
+            {
+                std::cerr << "Could not read file " << options.files[0] << std::endl;
+                return EXIT_FAILURE;
+            }
+            report.phase("contours_stream");
+            size_t loops = 0, points = 0;
+            for (const typename Mesh::Contour& c : contours) { loops += c.loops.size(); points += c.points.size(); }
+            log << "Contours: " << loops << " polylines and " << points << " points" << std::endl;
+            if (!slicer.save_contours(output, contours))
+            {
+                std::cerr << "Could not write file " << output << std::endl;
+                return EXIT_FAILURE;
+            }
+            log << "File " << output << " written" << std::endl;
+            report.phase("save");
+            return finish({ output });
+        }
 
+        if (slicer.planes.size() > 1)
+        {
+            std::cerr << "--stream only supports a single plane" << std::endl;
+            return EXIT_FAILURE;
+        }
 
+        bool cut = options.threads != 1 ? slicer.cut_pipelined(options.files[0], output)
+                 :                        slicer.cut_stream(options.files[0], output);
+        if (!cut)
+        {
+            std::cerr << "Could not cut file " << options.files[0] << " into " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+        log << "File " << options.files[0] << " cut into " << output << " (" << slicer.positions.size() << " vertices)" << std::endl;
+        report.phase(options.threads != 1 ? "cut_pipelined" : "cut_stream");
+        return finish({ output });
+    }
 
-    //
-    // Compute lambda such that lambda*P + (1-lambda)*Q
-    // is the intersection between the plane and line PQ.
-    //      lambda is in [0, 1]   =>  [PQ] intersects plane
-    //      lambda is infinite    =>  [PQ] parallel to plane
-    //      lambda is NaN         =>  [PQ] contained in plane
-    //
-    double get_lambda(Vector p, Vector q)
+    bool loaded = Mesh::is_binary(options.files[0]) ? slicer.load_binary(options.files[0])
+                : options.threads != 1            ? slicer.load_parallel(options.files[0], options.threads)
+                : options.mmap_load               ? slicer.load_mmap(options.files[0])
+                :                                   slicer.load(options.files[0]);
+    if (!loaded)
+    {
+        std::cerr << "Could not read file " << options.files[0] << std::endl;
+        return EXIT_FAILURE;
+    }
+    log << "File " << options.files[0] << " loaded" << std::endl;
+    report.phase("load");
+    if (options.reorder)
     {
-        double num = (origin[0] - q[0]) * normal[0]
-                   + (origin[1] - q[1]) * normal[1]
-                   + (origin[2] - q[2]) * normal[2];
+        slicer.reorder();
+        report.phase("reorder");
+    }
 
-        double den = (p[0] - q[0]) * normal[0]
-                   + (p[1] - q[1]) * normal[1]
-                   + (p[2] - q[2]) * normal[2];
+    if (options.serve)
+    {
+        slicer.build_index();
+        log << "Ready" << std::endl;
+        return serve(slicer, options.threads);
+    }
 
-        return num/den;
+    if (!slicer.read_json(options.files[1]))
+    {
+        std::cerr << "Could not read file " << options.files[1] << std::endl;
+        return EXIT_FAILURE;
     }
+    log << "File " << options.files[1] << " loaded";
+    if (slicer.planes.size() > 1) log << " (" << slicer.planes.size() << " planes)";
+    log << std::endl;
+    report.phase("read_json");
 
-    //
-    // If edge [ij] intersects plane, add intersection vertex to mesh and return its index.
-    // If the intersection vertex has already been computed before, only return its index.
-    // If intersection does not exist, return -1.
-    //
-    int get_intersection(int i, int j)
+    if (options.contour)
     {
-        // We require i<j.
-        if (i > j) std::swap(i, j);
-
-        // Compute lambda and return -1 if no intersection.
-        Vector p = positions[i];
-        Vector q = positions[j];
-        double lambda = get_lambda(p, q);
-        if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return -1;
-
-        // If the intersection has already been computed, return its index.
-        auto key = std::make_pair(i, j);
-        auto found = intersections.find(key);
-        if (found != intersections.end()) return found->second;
-
-        // Otherwise, compute the intersection, append it to the mesh, and return its index.
-        int m = positions.size();
-        positions.push_back(
+        std::vector<typename Mesh::Contour> contours;
+        slicer.contours(contours);
+        report.phase("contours");
+        size_t loops = 0, points = 0;
+        for (const typename Mesh::Contour& c : contours) { loops += c.loops.size(); points += c.points.size(); }
+        log << "Contours: " << loops << " polylines and " << points << " points" << std::endl;
+        if (!slicer.save_contours(output, contours))
         {
-            lambda*p[0] + (1-lambda)*q[0],
-            lambda*p[1] + (1-lambda)*q[1],
-            lambda*p[2] + (1-lambda)*q[2]
-        });
-        intersections[key] = m;
-        return m;
+            std::cerr << "Could not write file " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+        log << "File " << output << " written" << std::endl;
+        report.phase("save");
+        return finish({ output });
     }
 
+    if (Mesh::is_delta(output))
+    {
+        if (slicer.planes.size() > 1)
+        {
+            std::cerr << "Deltas only support a single plane" << std::endl;
+            return EXIT_FAILURE;
+        }
+        typename Mesh::Delta delta;
+        slicer.cut({ slicer.origin, slicer.normal }, delta);
+        report.phase("cut");
+        log << "Delta: " << delta.vertices.size() << " new vertices, " << delta.replaced.size() << " replaced and "
+                  << delta.appended.size() << " appended triangles" << std::endl;
+        if (!slicer.save_delta(output, delta))
+        {
+            std::cerr << "Could not write file " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+        log << "File " << output << " written" << std::endl;
+        report.phase("save");
+        return finish({ output });
+    }
 
+    log << "Before: " << slicer.positions.size() << " vertices and " << slicer.triangles.size() << " triangles" << std::endl;
+    if      (slicer.planes.size() > 1) slicer.cut_batch();
+    else if (options.threads != 1)     slicer.cut_parallel(options.threads);
+    else                               slicer.cut();
+    report.phase("cut");
+    if (options.stats) report.cut(stats);
+    log << "After: "  << slicer.positions.size() << " vertices and " << slicer.triangles.size() << " triangles" << std::endl;
 
-    //
-    // If triangle tid intersects plane, split it and returns true.
-    // Otherwise do nothing and return false.
-    //
-    bool do_triangle(int tid)
+    if (options.halves)
     {
-        for (int n=0 ; n<3 ; n++)
+        if (slicer.planes.size() > 1)
         {
-            int i = triangles[tid][n];
-            int j = triangles[tid][(n+1) % 3];
-            int k = triangles[tid][(n+2) % 3];
-
-            // If edge [jk] intersects plane.
-            int m = get_intersection(j, k);
-            if (m != -1)
-            {
-                triangles.push_back({ i, j, m });
-                triangles[tid] = { i, m, k };
-                return true;
-            }
+            std::cerr << "--split only supports a single plane" << std::endl;
+            return EXIT_FAILURE;
         }
-        return false;
+        std::string above, below;
+        split_names(output, above, below);
+        if (!slicer.save_halves(above, below))
+        {
+            std::cerr << "Could not write files " << above << " and " << below << std::endl;
+            return EXIT_FAILURE;
+        }
+        log << "Files " << above << " and " << below << " written" << std::endl;
+        report.phase("save");
+        return finish({ above, below });
     }
 
+    bool saved = Mesh::is_binary(output) ? slicer.save_binary(output) : slicer.save(output);
+    if (!saved)
+    {
+        std::cerr << "Could not write file " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+    log << "File " << output << " written" << std::endl;
+    report.phase("save");
 
+    return finish({ output });
+}
 
-public:
 
-    //
-    // Read JSON file with plane coordinates.
-    //
-    bool read_json(const std::string& filename)
-    {
-        std::string json;
-        std::ifstream file(filename);
-        if (!file) return false;
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-
-        json = buffer.str();
-        json = std::regex_replace(json, std::regex(".*\"origin\"[^[]+[[]", std::regex::extended), "");
-        json = std::regex_replace(json, std::regex("([]].*)|,",            std::regex::extended), "");
-        std::istringstream(json) >> origin[0] >> origin[1] >> origin[2];
-
-        json = buffer.str();
-        json = std::regex_replace(json, std::regex(".*\"normal\"[^[]+[[]", std::regex::extended), "");
-        json = std::regex_replace(json, std::regex("([]].*)|,",            std::regex::extended), "");
-        std::istringstream(json) >> normal[0] >> normal[1] >> normal[2];
-
-        return true;
-
-        // Note: I am aware that parsing a JSON file using regular expressions is bad practice,
-        // and that the above code is difficult to understand and will fail for some inputs.
-        // This is only a toy project.
-    }
 
-};
+//
+// Print the command-line usage.
+//
+static void usage(const char* program)
+{
+    std::cout << "Usage: " << program << " " << "[options] torus.obj plane.json [output.obj]" << std::endl;
+    std::cout << "This will cut torus.obj by plane.json and save the result in output.obj" << std::endl;
+    std::cout << "   or: " << program << " " << "--serve [options] torus.obj" << std::endl;
+    std::cout << "This will load torus.obj and cut it by the planes read from the standard input" << std::endl;
+    std::cout << "   or: " << program << " " << "--batch [options] manifest.txt" << std::endl;
+    std::cout << "This will run the \"mesh.obj plane.json output.obj\" jobs listed in manifest.txt" << std::endl;
+    std::cout << "Files ending in .mmsb are read and written in the binary mesh format" << std::endl;
+    std::cout << "An output ending in .mmsd only saves the changes made by the cut, in the binary delta format" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    --mmap          Load the mesh with the memory-mapped loader" << std::endl;
+    std::cout << "    --threads N     Load and cut the mesh with N threads (all for all cores)" << std::endl;
+    std::cout << "    --soa           Classify vertices with SIMD from a structure-of-arrays copy" << std::endl;
+    std::cout << "    --float         Classify vertices in single precision" << std::endl;
+    std::cout << "    --reorder       Sort faces and vertices for memory locality after loading (output keeps the input order)" << std::endl;
+    std::cout << "    --robust        Decide the side of vertices near the plane exactly, and snap them to it" << std::endl;
+    std::cout << "    --offload       Classify vertices and find crossing triangles on a GPU, if built with OpenMP offloading" << std::endl;
+    std::cout << "    --contour       Only save the intersection polylines, as OBJ lines (with --stream, without loading the mesh)" << std::endl;
+    std::cout << "    --stream        Cut an OBJ file without loading all its faces in memory" << std::endl;
+    std::cout << "                    (with --threads other than 1, reading, cutting and writing overlap)" << std::endl;
+    std::cout << "    --split         Save the parts above and below the plane to output_above.obj and output_below.obj" << std::endl;
+    std::cout << "    --scalar T      Store coordinates as float or double (default)" << std::endl;
+    std::cout << "    --index N       Store vertex indices on 32 (default) or 64 bits" << std::endl;
+    std::cout << "    --serve         Answer \"ox oy oz nx ny nz output.obj\" requests, with --threads N concurrent cuts" << std::endl;
+    std::cout << "    --batch         Run the jobs of a manifest, with --threads N concurrent jobs" << std::endl;
+    std::cout << "    --stats         Print phase timings and cut counters (--stats-json for JSON only on the standard output)" << std::endl;
+}
 
 
 
@@ -282,40 +611,77 @@ public:
 //
 int main(int argc, char *argv[])
 {
-    if (argc < 3)
+    // Split arguments into options and file names.
+    Options options;
+    std::string scalar = "double";
+    unsigned index = 32;
+    for (int a = 1 ; a < argc ; a++)
     {
-        std::cout << "Usage: " << argv[0] << " " << "torus.obj plane.json" << std::endl;
-        std::cout << "This will cut torus.obj by plane.json and save the result in output.obj" << std::endl;
-        return EXIT_SUCCESS;
+        std::string arg = argv[a];
+        if      (arg == "--mmap") options.mmap_load = true;
+        else if (arg == "--threads" && a+1 < argc)
+        {
+            // A positive number of threads, or "all" (0) for all cores.
+            const char* value = argv[++a];
+            char* end = nullptr;
+            long threads = std::strtol(value, &end, 10);
+            if (std::strcmp(value, "all") == 0) options.threads = 0;
+            else if (end == value || *end != 0 || threads <= 0 || threads > 4096)
+            {
+                std::cerr << "Invalid --threads " << value << " (expected a number of threads from 1 to 4096, or all)" << std::endl;
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            else options.threads = unsigned(threads);
+        }
+        else if (arg == "--soa")   options.soa = true;
+        else if (arg == "--float") options.float_classify = true;
+        else if (arg == "--robust") options.robust = true;
+        else if (arg == "--offload") options.offload = true;
+        else if (arg == "--reorder") options.reorder = true;
+        else if (arg == "--contour") options.contour = true;
+        else if (arg == "--stream")  options.stream = true;
+        else if (arg == "--split")   options.halves = true;
+        else if (arg == "--scalar" && a+1 < argc) scalar = argv[++a];
+        else if (arg == "--index" && a+1 < argc)  index = std::atoi(argv[++a]);
+        else if (arg == "--serve")       options.serve = true;
+        else if (arg == "--batch")       options.batch = true;
+        else if (arg == "--stats")       options.stats = true;
+        else if (arg == "--stats-json")  options.stats = options.stats_json = true;
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        else options.files.push_back(arg);
     }
 
-    Slicer slicer;
+    if (options.files.size() < (options.serve || options.batch ? 1u : 2u))
+    {
+        usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
 
-    if (!slicer.load(argv[1]))
+    // Batch jobs load their mesh, so they can't be streamed.
+    if (options.batch && options.stream)
     {
-        std::cerr << "Could not read file " << argv[1] << std::endl;
+        std::cerr << "--batch doesn't support --stream" << std::endl;
         return EXIT_FAILURE;
     }
-    std::cout << "File " << argv[1] << " loaded" << std::endl;
 
-    if (!slicer.read_json(argv[2]))
+    // Served cuts are const delta cuts, which only use the loading options.
+    if (options.serve && (options.soa || options.float_classify || options.robust || options.offload
+                       || options.contour || options.stream || options.halves || options.batch || options.stats))
     {
-        std::cerr << "Could not read file " << argv[2] << std::endl;
+        std::cerr << "--serve doesn't support --soa, --float, --robust, --offload, --contour, --stream, --split, --batch or --stats" << std::endl;
         return EXIT_FAILURE;
     }
-    std::cout << "File " << argv[2] << " loaded" << std::endl;
 
-    std::cout << "Before: " << slicer.positions.size() << " vertices and " << slicer.triangles.size() << " triangles" << std::endl;
-    slicer.cut();
-    std::cout << "After: "  << slicer.positions.size() << " vertices and " << slicer.triangles.size() << " triangles" << std::endl;
-
-    if (!slicer.save("output.obj"))
+    if ((scalar != "float" && scalar != "double") || (index != 32 && index != 64))
     {
-        std::cerr << "Could not write file output.obj" << std::endl;
+        std::cerr << "Unsupported --scalar " << scalar << " or --index " << index << std::endl;
         return EXIT_FAILURE;
     }
-    std::cout << "File output.obj written" << std::endl;
-
-    return EXIT_SUCCESS;
+    if (scalar == "float") return index == 32 ? run<float, uint32_t>(options) : run<float, uint64_t>(options);
+    else                   return index == 32 ? run<double, uint32_t>(options) : run<double, uint64_t>(options);
 }
-
@@ -0,0 +1,4222 @@
+#ifndef SLICER_H
+#define SLICER_H
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <chrono>
+
+// Shortest round-trip float formatting is available from C++17.
+#ifndef SLICER_TO_CHARS
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#if defined(__cpp_lib_to_chars)
+#define SLICER_TO_CHARS 1
+#else
+#define SLICER_TO_CHARS 0
+#endif
+#endif
+
+// SIMD instruction sets used by the classification kernels, chosen at compile time (e.g. with -march=native).
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SLICER_NEON 1
+#else
+#define SLICER_NEON 0
+#endif
+
+// Memory-mapped file reading is available on POSIX systems.
+#ifndef SLICER_MMAP
+#if defined(__unix__) || defined(__APPLE__)
+#define SLICER_MMAP 1
+#else
+#define SLICER_MMAP 0
+#endif
+#endif
+
+#if SLICER_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Offloading of the classification to a GPU, through OpenMP target regions (OpenMP 4.5, e.g. -fopenmp
+// with a compiler configured for offloading). Without an offloading device, cuts run on the CPU.
+#ifndef SLICER_OFFLOAD
+#if defined(_OPENMP) && _OPENMP >= 201511
+#define SLICER_OFFLOAD 1
+#else
+#define SLICER_OFFLOAD 0
+#endif
+#endif
+
+#if SLICER_OFFLOAD
+#include <omp.h>
+#endif
+
+/*
+
+    MINIMALISTIC MESH SLICER
+
+    Quick usage:
+
+        Slicer slicer;
+        slicer.load("torus.obj");
+        slicer.read_json("plane.json");
+        slicer.cut();
+        slicer.save("output.obj");
+
+    The class is header-only, so it can also be used as a library on caller-owned buffers:
+
+        Slicer slicer;
+        Slicer::MeshView<float, uint32_t> mesh = { positions, vertex_count, indices, triangle_count };
+        Slicer::MeshOutput<float, uint32_t> output;
+        slicer.cut(mesh, { origin, normal }, output);
+
+    There is only minimal error and edge-case handling.
+    See README.md for more details.
+
+*/
+
+//
+// Numeric settings for each scalar type of BasicSlicer.
+//
+template<typename Scalar>
+struct SlicerTraits;
+
+template<>
+struct SlicerTraits<double>
+{
+    // Relative position along an edge under which an intersection is merged with the edge end.
+    static constexpr double precision() { return 0.00001; }
+};
+
+template<>
+struct SlicerTraits<float>
+{
+    // Single precision vertices are only accurate to about 1e-7, so intersections are merged sooner.
+    static constexpr double precision() { return 0.0001; }
+};
+
+//
+// Mesh slicer storing coordinates as Scalar (float or double)
+// and vertex indices as Index (a signed or unsigned integer type, e.g. int, uint32_t or uint64_t).
+//
+template<typename Scalar = double, typename Index = int>
+class BasicSlicer
+{
+
+public:
+
+    // Vertex and face data.
+    using Vector            = std::array<Scalar, 3>;
+    using Triangle          = std::array<Index, 3>;
+    std::vector<Vector>     positions;
+    std::vector<Triangle>   triangles;
+
+    // Missing vertex index (-1, or the largest value for unsigned types).
+    static constexpr Index none = Index(-1);
+
+    // Cutting plane used for slicing.
+    Vector origin;
+    Vector normal;
+
+    // Planes used by cut_batch, set by read_json or set_planes.
+    struct Plane
+    {
+        Vector origin;
+        Vector normal;
+    };
+    std::vector<Plane> planes;
+
+    // Borrowed view of a caller-owned mesh: vertex_count vertices stored as interleaved x, y, z,
+    // and triangle_count triangles stored as 3 vertex indices each.
+    // Scalar is float or double, and Index any integer type (e.g. uint32_t).
+    template<typename ViewScalar, typename ViewIndex>
+    struct MeshView
+    {
+        const ViewScalar*   positions;
+        size_t              vertex_count;
+        const ViewIndex*    indices;
+        size_t              triangle_count;
+    };
+
+    // Result of cutting a MeshView: the intersection vertices, numbered after the vertices of the view
+    // (vertex vertex_count+k is positions[3*k], positions[3*k+1], positions[3*k+2]),
+    // and the index buffer of the whole cut mesh. Buffers keep their capacity from one cut to the next.
+    template<typename ViewScalar, typename ViewIndex>
+    struct MeshOutput
+    {
+        std::vector<ViewScalar> positions;
+        std::vector<ViewIndex>  indices;
+    };
+
+    // Classification options.
+    // With soa, a structure-of-arrays copy of positions (separate x, y and z arrays) is kept
+    // and updated by cut, so that signed distances are computed with SIMD instructions.
+    // With float_classify, signed distances are computed in single precision,
+    // which is faster but makes intersection points less accurate.
+    bool soa            = false;
+    bool float_classify = false;
+
+    // With indexed, cut keeps a bounding volume hierarchy over triangles between calls,
+    // so that repeated cuts of the same mesh only visit the triangles near the plane.
+    // The index is rebuilt when the mesh was changed by anything else than an indexed cut.
+    bool indexed        = false;
+
+    // With edge_indexed, cut keeps an edge table (an edge index for each triangle side)
+    // and stores intersection vertices per edge instead of looking them up in a hash table.
+    // The table is built on the first cut that needs it, and kept up to date by later cuts.
+    // The other ways of cutting (cut_stream, cut_parallel, cut_batch...) don't use it.
+    bool edge_indexed   = false;
+
+    // With robust, cut and cut_parallel decide the side of the vertices near the plane consistently:
+    // a distance within its rounding error bound gets the sign of the exact distance (computed with
+    // error-free transformations), or zero if the sign was wrong. Then vertices so close to the plane
+    // that one of their edges would be cut within precision of them are snapped to the plane
+    // (their distance is set to zero, their position is unchanged). Every crossing triangle is then
+    // split at most twice, and no crossing triangle is left unsplit.
+    bool robust         = false;
+
+    // With offload, cut computes the signed distances and finds the crossing triangles on the default
+    // OpenMP device (see SLICER_OFFLOAD). Only the crossing triangles and the distances of their vertices
+    // are copied back, and split on the CPU. Without a device (see offload_devices), or with indexed
+    // or robust, cut classifies on the CPU instead. Device arithmetic may round distances differently.
+    bool offload        = false;
+
+    // Statistics of the last cut, filled in when stats is set (by cut, cut_parallel and cut_batch).
+    // get_intersection counts each lookup of an intersection vertex as a hit or a miss, and do_triangle
+    // counts the splits of the triangle it split last, behind a test of stats, so that cuts without
+    // stats only pay for that test. Splits follow from the number of triangles before and after the cut.
+    struct Stats
+    {
+        double  classify_seconds = 0;   // Signed distances and count of crossing triangles.
+        double  split_seconds    = 0;   // Splitting loop.
+        size_t  crossing         = 0;   // Triangles with vertices strictly on both sides of the plane.
+        size_t  splits           = 0;   // Successful do_triangle calls.
+        size_t  retries          = 0;   // Splits of a triangle that the previous do_triangle call split too.
+        size_t  hits             = 0;   // Intersection lookups that found an existing vertex.
+        size_t  misses           = 0;   // Intersection lookups that created a new vertex.
+        size_t  snapped          = 0;   // Vertices snapped to the plane by robust cuts.
+    };
+    Stats* stats = nullptr;
+
+    // After reorder, the original index of each vertex and triangle (empty otherwise).
+    // Vertices and triangles added later by cuts keep their index.
+    std::vector<Index>      original_vertices;
+    std::vector<Index>      original_triangles;
+
+
+
+    //
+    // Clear mesh.
+    //
+    void clear()
+    {
+        positions.clear();
+        triangles.clear();
+        columns.clear();
+        float_columns.clear();
+        index.clear();
+        edge_table.clear();
+        original_vertices.clear();
+        original_triangles.clear();
+    }
+
+
+
+    //
+    // Reorder the mesh for memory locality, keeping the original order for save and save_binary.
+    //
+    // Triangles are sorted along a Morton curve through their centroids (quantized on 21 bits per axis
+    // in the bounding box of the mesh), and vertices are renumbered in order of first use, so that
+    // triangles close in space, and their vertices, are close in memory. Unused vertices go last.
+    // The original indices are kept in original_vertices and original_triangles.
+    //
+    void reorder()
+    {
+        const size_t nv = positions.size(), nt = triangles.size();
+        if (nt == 0) return;
+
+        // Morton code of each triangle.
+        Vector lo = positions[triangles[0][0]], hi = lo;
+        for (const Triangle& t : triangles) for (Index v : t) for (int a = 0 ; a < 3 ; a++)
+        {
+            lo[a] = std::min(lo[a], positions[v][a]);
+            hi[a] = std::max(hi[a], positions[v][a]);
+        }
+        std::vector<std::pair<uint64_t, Index>> keys(nt);
+        for (size_t tid = 0 ; tid < nt ; tid++)
+        {
+            uint64_t code = 0;
+            for (int a = 0 ; a < 3 ; a++)
+            {
+                const Triangle& t = triangles[tid];
+                double center = (double(positions[t[0]][a]) + positions[t[1]][a] + positions[t[2]][a]) / 3;
+                double scale  = hi[a] > lo[a] ? double((1 << 21) - 1) / (double(hi[a]) - lo[a]) : 0;
+                uint64_t cell = uint64_t(std::max(0.0, std::min(double((1 << 21) - 1), (center - lo[a]) * scale)));
+                code |= interleave(cell) << a;
+            }
+            keys[tid] = std::make_pair(code, Index(tid));
+        }
+        std::sort(keys.begin(), keys.end());
+
+        // Renumber vertices in order of first use.
+        std::vector<Index> renumber(nv, none), vertex_order, triangle_order(nt);
+        vertex_order.reserve(nv);
+        std::vector<Triangle> sorted(nt);
+        for (size_t k = 0 ; k < nt ; k++)
+        {
+            triangle_order[k] = keys[k].second;
+            for (int c = 0 ; c < 3 ; c++)
+            {
+                Index v = triangles[keys[k].second][c];
+                if (renumber[v] == none) { renumber[v] = Index(vertex_order.size()); vertex_order.push_back(v); }
+                sorted[k][c] = renumber[v];
+            }
+        }
+        for (size_t v = 0 ; v < nv ; v++) if (renumber[v] == none) vertex_order.push_back(Index(v));
+        std::vector<Vector> moved(nv);
+        for (size_t v = 0 ; v < nv ; v++) moved[v] = positions[vertex_order[v]];
+        positions.swap(moved);
+        triangles.swap(sorted);
+
+        // Compose with the previous reordering, if any.
+        for (Index& v : vertex_order)   if (size_t(v) < original_vertices.size())  v = original_vertices[v];
+        for (Index& t : triangle_order) if (size_t(t) < original_triangles.size()) t = original_triangles[t];
+        original_vertices.swap(vertex_order);
+        original_triangles.swap(triangle_order);
+
+        // Derived data refers to the old indices.
+        columns.clear();
+        float_columns.clear();
+        index.clear();
+        edge_table.clear();
+    }
+
+
+
+    //
+    // Load OBJ file.
+    //
+    bool load(std::string filename)
+    {
+        clear();
+
+        // Open the file.
+        std::ifstream file(filename);
+        if (!file) return false;
+
+        // Read file line by line.
+        std::string line;
+        while (std::getline(file, line))
+        {
+            // Read first word in line.
+            std::istringstream iss(line);
+            std::string prefix;
+            iss >> prefix;
+
+            // If vertex.
+            if (prefix == "v")
+            {
+                Vector p;
+                iss >> p[0] >> p[1] >> p[2];
+                positions.push_back(p);
+            }
+            
+            // If face (triangulated as in the fast loaders).
+            else if (prefix == "f")
+            {
+                const char* s = line.data() + line.find('f') + 1;
+                parse_face(s, line.data() + line.size(), positions.size(), triangles);
+            }
+
+            // If something else.
+            else
+            {
+                // We ignore the line if it's not a vertex or triangle.
+            }
+        }
+
+        return true;
+    }
+
+
+
+    //
+    // Load OBJ file, faster version.
+    // The file is memory-mapped and parsed in place, without per-line allocations.
+    //
+    bool load_mmap(const std::string& filename)
+    {
+        clear();
+
+        // Map the file.
+        MappedFile file;
+        if (!file.open(filename)) return false;
+        const char* begin = file.data;
+        const char* end   = file.data + file.size;
+
+        // Parse vertices and triangles.
+        parse_chunk(begin, end, positions, triangles);
+
+        return true;
+    }
+
+
+
+    //
+    // Load OBJ file, multi-threaded version.
+    // The file is split into chunks on line boundaries, each thread parses one chunk into local arrays,
+    // and the local arrays are then concatenated in file order.
+    // The result is identical to load and load_mmap.
+    // If threads is 0, the number of hardware threads is used.
+    //
+    bool load_parallel(const std::string& filename, unsigned threads = 0)
+    {
+        clear();
+
+        // Map the file.
+        MappedFile file;
+        if (!file.open(filename)) return false;
+        const char* begin = file.data;
+        const char* end   = file.data + file.size;
+
+        // Split the file into one chunk per thread.
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<const char*> bounds(threads + 1, end);
+        bounds[0] = begin;
+        for (unsigned w = 1 ; w < threads ; w++)
+        {
+            const char* s = std::max(bounds[w-1], begin + file.size * w / threads);
+            bounds[w] = (s == begin || s[-1] == '\n') ? s : next_line(s, end);
+        }
+
+        // Parse each chunk in its own thread.
+        // Negative (relative) face indices are resolved within the chunk, and shifted when merging.
+        std::vector<std::vector<Vector>>   local_positions(threads);
+        std::vector<std::vector<Triangle>> local_triangles(threads);
+        std::vector<std::vector<size_t>>   local_relative(threads);
+        auto parse = [&](unsigned w)
+        {
+            parse_chunk(bounds[w], bounds[w+1], local_positions[w], local_triangles[w], &local_relative[w]);
+        };
+        run_parallel(threads, parse);
+
+        // Concatenate the chunks in file order.
+        std::vector<size_t> vertex_offsets(threads + 1, 0), triangle_offsets(threads + 1, 0);
+        for (unsigned w = 0 ; w < threads ; w++)
+        {
+            vertex_offsets[w+1]   = vertex_offsets[w]   + local_positions[w].size();
+            triangle_offsets[w+1] = triangle_offsets[w] + local_triangles[w].size();
+        }
+        positions.resize(vertex_offsets[threads]);
+        triangles.resize(triangle_offsets[threads]);
+        auto merge = [&](unsigned w)
+        {
+            std::copy(local_positions[w].begin(), local_positions[w].end(), positions.begin() + vertex_offsets[w]);
+            std::copy(local_triangles[w].begin(), local_triangles[w].end(), triangles.begin() + triangle_offsets[w]);
+            for (size_t corner : local_relative[w])
+            {
+                Index& v = triangles[triangle_offsets[w] + corner / 3][corner % 3];
+                v = Index(v + vertex_offsets[w]);
+            }
+            std::vector<Vector>().swap(local_positions[w]);
+            std::vector<Triangle>().swap(local_triangles[w]);
+        };
+        run_parallel(threads, merge);
+
+        return true;
+    }
+
+
+
+    //
+    // Save OBJ file.
+    // Output goes through a large buffer which is written in big blocks,
+    // and numbers are formatted with the shortest representation that reads back exactly.
+    //
+    bool save(std::string filename)
+    {
+        // Open the file.
+        Writer file;
+        if (!file.open(filename)) return false;
+
+        // Restore the original order, after reorder.
+        std::vector<Vector> restored_positions;
+        std::vector<Triangle> restored_triangles;
+        bool restored = restore(restored_positions, restored_triangles);
+
+        // Write vertices.
+        for (const Vector& p : restored ? restored_positions : positions) file.put_vertex(p);
+
+        // Write triangles.
+        for (const Triangle& t : restored ? restored_triangles : triangles) file.put_triangle(t);
+
+        return file.close();
+    }
+
+
+
+    //
+    // Load binary mesh file written by save_binary.
+    // The vertex and triangle arrays are copied straight from the memory-mapped file.
+    // A file whose sizes don't match its header, or with a vertex index out of range, is rejected.
+    //
+    bool load_binary(const std::string& filename)
+    {
+        clear();
+
+        // Map the file and check the header.
+        MappedFile file;
+        if (!file.open(filename)) return false;
+        BinaryHeader header;
+        if (file.size < sizeof(header)) return false;
+        std::memcpy(&header, file.data, sizeof(header));
+        if (!header.valid()) return false;
+
+        // Check the counts against the file size before multiplying, so that a corrupt header can't overflow.
+        size_t available = file.size - sizeof(header);
+        if (header.vertex_count > available / sizeof(Vector)) return false;
+        size_t vertex_bytes = size_t(header.vertex_count) * sizeof(Vector);
+        if (header.triangle_count > (available - vertex_bytes) / sizeof(Triangle)) return false;
+        size_t triangle_bytes = size_t(header.triangle_count) * sizeof(Triangle);
+        if (available != vertex_bytes + triangle_bytes) return false;
+
+        // Copy the arrays.
+        positions.resize(header.vertex_count);
+        triangles.resize(header.triangle_count);
+        if (vertex_bytes)   std::memcpy(positions.data(), file.data + sizeof(header), vertex_bytes);
+        if (triangle_bytes) std::memcpy(triangles.data(), file.data + sizeof(header) + vertex_bytes, triangle_bytes);
+
+        // Every triangle must refer to vertices of the file.
+        for (const Triangle& t : triangles)
+        {
+            for (Index v : t)
+            {
+                if (size_t(v) < positions.size()) continue;
+                clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+
+    //
+    // Save binary mesh file.
+    // The file is a BinaryHeader followed by the raw positions and triangles arrays
+    // (in native byte order), so it can be read back with a plain copy.
+    //
+    bool save_binary(const std::string& filename)
+    {
+        // Open the file.
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file) return false;
+
+        // Restore the original order, after reorder.
+        std::vector<Vector> restored_positions;
+        std::vector<Triangle> restored_triangles;
+        bool restored = restore(restored_positions, restored_triangles);
+        const std::vector<Vector>&   p = restored ? restored_positions  : positions;
+        const std::vector<Triangle>& t = restored ? restored_triangles : triangles;
+
+        // Write header and arrays.
+        BinaryHeader header;
+        header.vertex_count   = p.size();
+        header.triangle_count = t.size();
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+               && std::fwrite(p.data(), sizeof(Vector),   p.size(), file) == p.size()
+               && std::fwrite(t.data(), sizeof(Triangle), t.size(), file) == t.size();
+
+        return std::fclose(file) == 0 && ok;
+    }
+
+
+
+    //
+    // Tell if a file name has the binary mesh extension (.mmsb).
+    //
+    static bool is_binary(const std::string& filename)
+    {
+        static const std::string extension = ".mmsb";
+        return filename.size() >= extension.size()
+            && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+
+
+    //
+    // Slice mesh by plane.
+    //
+    void cut()
+    {
+        // We loop on all triangle indices (tid) in the mesh.
+        // The do_triangle function is called on each tid,
+        // and will split the triangle when required.
+        //
+        // If do_triangle returns false, the triangle doesn't intersect the mesh.
+        // The mesh (and triangle) is unchanged and we go the next triangle (tid+=1).
+        //
+        // If do_triangle return true, the triangle intersects the mesh.
+        // The triangle has been modified and a new triangle has been appended to the mesh.
+        // Since the modified triangle might still require splitting, we stay on it (tid+=0).
+        // The new appended triangle will be processed at the end.
+        //
+        // See do_triangle.png for a picture.
+        //
+        // The signed distance of every vertex to the plane is computed first.
+        // Triangles with no vertices strictly on both sides of the plane are skipped
+        // right away, without calling do_triangle.
+
+        reset_counters();
+        if (edge_indexed)
+        {
+            if (edge_table.size() != triangles.size()) edge_table.build(triangles);
+            edge_table.begin();
+            edge_cut = true;
+        }
+        if (indexed) { cut_indexed(); edge_cut = false; return; }
+        if (offload && !robust && offload_devices() > 0 && cut_offload(omp_device())) { edge_cut = false; return; }
+        const size_t count = triangles.size();
+        const double start = seconds();
+        classify();
+        if (robust) snap(nullptr);
+
+        // Each crossing triangle has two crossing edges, which are shared with a neighbour.
+        size_t crossing = 0;
+        for (const Triangle& t : triangles) crossing += crosses(t);
+        intersections.clear(crossing);
+        reserve_cut(crossing);
+
+        const double classified = seconds();
+        split(0);
+        edge_cut = false;
+        record(count, crossing, start, classified);
+    }
+
+    //
+    // Number of devices that cut can offload to (0 if compiled without SLICER_OFFLOAD).
+    //
+    static int offload_devices()
+    {
+        #if SLICER_OFFLOAD
+        return omp_get_num_devices();
+        #else
+        return 0;
+        #endif
+    }
+
+
+
+    //
+    // Split the mesh (once cut) into the parts above and below the plane.
+    //
+    // A triangle goes to the side of its vertex farthest from the plane, so that triangles
+    // touching the plane, or too close to it to be split, go to the side where most of their area is.
+    // Triangles lying in the plane go below. Each half is built by its own thread,
+    // in a single pass over the triangles which compacts its vertices in order of first use.
+    //
+    void separate(BasicSlicer& above, BasicSlicer& below)
+    {
+        classify();
+        BasicSlicer* halves[2] = { &below, &above };
+        run_parallel(2, [&](unsigned w) { extract(int(w), *halves[w]); });
+    }
+
+    //
+    // Same as separate, writing the two halves to files above and below, each from its own thread.
+    //
+    bool save_halves(const std::string& above, const std::string& below)
+    {
+        classify();
+        const std::string* filenames[2] = { &below, &above };
+        bool saved[2] = { false, false };
+        run_parallel(2, [&](unsigned w)
+        {
+            BasicSlicer half;
+            extract(int(w), half);
+            saved[w] = is_binary(*filenames[w]) ? half.save_binary(*filenames[w]) : half.save(*filenames[w]);
+        });
+        return saved[0] && saved[1];
+    }
+
+
+
+    //
+    // Slice the OBJ file input by plane and write the result to the OBJ file output,
+    // without loading the whole mesh in memory.
+    //
+    // The input is read twice, in chunks of lines. The first pass only reads the vertices,
+    // which are classified and written out. The second pass reads the faces chunk by chunk:
+    // each chunk is split as in cut and written out right away, preceded by the intersection
+    // vertices it created. Memory use depends on the number of vertices and crossing edges,
+    // not on the number of faces. Afterwards, positions holds the input and intersection vertices,
+    // and triangles is empty.
+    //
+    bool cut_stream(const std::string& input, const std::string& output)
+    {
+        reset_counters();
+        LineReader reader;
+        if (!read_vertices(input, reader)) return false;
+        const char* begin;
+        const char* end;
+
+        // Write vertices.
+        Writer file;
+        if (!file.open(output)) return false;
+        for (const Vector& p : positions) file.put_vertex(p);
+
+        classify();
+        intersections.clear();
+
+        // Read, split and write faces.
+        // Vertices are counted again, for relative face indices.
+        size_t written = positions.size(), seen = 0;
+        reader.rewind();
+        while (reader.next(begin, end))
+        {
+            triangles.clear();
+            read_faces(begin, end, seen, triangles);
+            split(0);
+            for ( ; written < positions.size() ; written++) file.put_vertex(positions[written]);
+            for (const Triangle& t : triangles) file.put_triangle(t);
+        }
+        triangles.clear();
+
+        return reader.ok && file.close();
+    }
+
+    //
+    // Same as cut_stream, with reading, splitting and writing running concurrently on three threads.
+    //
+    // The stages are connected by queues of at most depth chunks, so a fast stage waits for the
+    // slower ones instead of buffering the whole file, and the total time is close to the time
+    // of the slowest stage. The reader only parses faces, the splitter owns positions and triangles,
+    // and the writer formats and writes each split chunk preceded by its new vertices.
+    // The output is the same as with cut_stream.
+    //
+    bool cut_pipelined(const std::string& input, const std::string& output, size_t depth = 4)
+    {
+        reset_counters();
+        LineReader reader;
+        if (!read_vertices(input, reader)) return false;
+        const char* begin;
+        const char* end;
+
+        Writer file;
+        if (!file.open(output)) return false;
+        intersections.clear();
+
+        // The input vertices are written while the splitter classifies them,
+        // and must be written before it appends to positions.
+        BoundedQueue<std::vector<Triangle>> faces(depth);
+        BoundedQueue<Piece>                 pieces(depth);
+        std::promise<void> written;
+        std::future<void>  ready = written.get_future();
+        const size_t count = positions.size();
+
+        auto stage = [&](unsigned w)
+        {
+            if (w == 0)
+            {
+                // Read faces, chunk by chunk.
+                size_t seen = 0;
+                reader.rewind();
+                while (reader.next(begin, end))
+                {
+                    std::vector<Triangle> chunk;
+                    read_faces(begin, end, seen, chunk);
+                    if (!chunk.empty()) faces.push(std::move(chunk));
+                }
+                faces.close();
+            }
+            else if (w == 1)
+            {
+                // Split each chunk, and pass it on with the vertices it created.
+                classify();
+                ready.wait();
+                Piece piece;
+                while (faces.pop(triangles))
+                {
+                    size_t first = positions.size();
+                    split(0);
+                    piece.vertices.assign(positions.begin() + first, positions.end());
+                    piece.triangles.swap(triangles);
+                    pieces.push(std::move(piece));
+                    piece = Piece();
+                }
+                pieces.close();
+            }
+            else
+            {
+                // Write the input vertices, then the split chunks in order.
+                for (size_t v = 0 ; v < count ; v++) file.put_vertex(positions[v]);
+                written.set_value();
+                Piece piece;
+                while (pieces.pop(piece))
+                {
+                    for (const Vector& p : piece.vertices)    file.put_vertex(p);
+                    for (const Triangle& t : piece.triangles) file.put_triangle(t);
+                }
+            }
+        };
+        run_parallel(3, stage);
+        triangles.clear();
+
+        return reader.ok && file.close();
+    }
+
+
+
+    //
+    // Slice the caller-owned mesh by plane, without copying its vertices.
+    //
+    // This is the same algorithm as cut, with the input vertices read from the view and the new ones
+    // written to output. The distances and intersections of this Slicer are used as scratch buffers,
+    // so reusing the same Slicer (and output) for the next cuts avoids allocations.
+    // Vertex indices of the cut mesh must fit in Index.
+    //
+    template<typename ViewScalar, typename ViewIndex>
+    void cut(const MeshView<ViewScalar, ViewIndex>& mesh, const Plane& plane, MeshOutput<ViewScalar, ViewIndex>& output)
+    {
+        ViewCut<ViewScalar, ViewIndex> view = { mesh, output, distances, intersections };
+        output.positions.clear();
+        output.indices.assign(mesh.indices, mesh.indices + 3*mesh.triangle_count);
+
+        // Compute signed distances from the view.
+        const Vector& o = plane.origin;
+        const Vector& n = plane.normal;
+        distances.resize(mesh.vertex_count);
+        for (size_t v = 0 ; v < mesh.vertex_count ; v++)
+        {
+            const ViewScalar* p = mesh.positions + 3*v;
+            distances[v] = (p[0] - o[0]) * n[0]
+                         + (p[1] - o[1]) * n[1]
+                         + (p[2] - o[2]) * n[2];
+        }
+
+        size_t crossing = 0;
+        for (size_t tid = 0 ; tid < mesh.triangle_count ; tid++) crossing += view.crosses(tid);
+        intersections.clear(crossing);
+        output.positions.reserve(3 * 2*crossing);
+        output.indices.reserve(output.indices.size() + 3 * 2*crossing);
+        distances.reserve(distances.size() + 2*crossing);
+
+        for (size_t tid = 0 ; tid < output.indices.size() / 3 ; )
+        {
+            if (!view.crosses(tid)) tid++;
+            else tid += !view.do_triangle(tid);
+        }
+    }
+
+
+
+    //
+    // Set planes to count parallel planes, the first one going through origin,
+    // and the next ones spaced by spacing along normal.
+    //
+    void set_planes(const Vector& first, const Vector& direction, double spacing, int count)
+    {
+        double length = std::sqrt(direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2]);
+        planes.clear();
+        for (int k = 0 ; k < count ; k++)
+        {
+            double step = k * spacing / length;
+            planes.push_back({ {{ Scalar(first[0] + step*direction[0]), Scalar(first[1] + step*direction[1]), Scalar(first[2] + step*direction[2]) }}, direction });
+        }
+        if (!planes.empty())
+        {
+            origin = planes[0].origin;
+            normal = planes[0].normal;
+        }
+    }
+
+
+
+    //
+    // Slice mesh by all planes in planes.
+    //
+    void cut_batch()
+    {
+        // If the planes are parallel, they are all handled in a single pass over the mesh.
+        //
+        // The signed distance d[v] of each vertex to the first plane is computed once,
+        // and the other planes are at sorted offsets h[0] < h[1] < ... along the same normal.
+        // The slab of a vertex is the number of planes strictly below it, so a triangle can only
+        // be crossed by the planes from the lowest to the highest slab of its vertices.
+        //
+        // Each crossed triangle is split by these planes in increasing order, like in cut.
+        // After plane k, only the pieces that are above plane k still need splitting.
+        // New vertices on plane k get d = h[k]. There is one intersections table per plane.
+        //
+        // If the planes are not parallel, the mesh is simply cut by each plane in turn.
+
+        reset_counters();
+        if (planes.empty()) return;
+        origin = planes[0].origin;
+        normal = planes[0].normal;
+        if (planes.size() == 1) { cut(); return; }
+
+        // Offsets of the planes along the normal of the first one.
+        offsets.clear();
+        for (const Plane& plane : planes)
+        {
+            if (!parallel(plane.normal, normal))
+            {
+                for (const Plane& p : planes) { origin = p.origin; normal = p.normal; cut(); }
+                return;
+            }
+            offsets.push_back(distance(plane.origin, origin, normal));
+        }
+        std::sort(offsets.begin(), offsets.end());
+        offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+        // Classify vertices into slabs.
+        const size_t count = triangles.size();
+        const double start = seconds();
+        classify();
+        std::vector<int> slabs(positions.size());
+        for (size_t v = 0 ; v < positions.size() ; v++)
+        {
+            slabs[v] = std::lower_bound(offsets.begin(), offsets.end(), distances[v]) - offsets.begin();
+        }
+
+        const double classified = seconds();
+        slab_intersections.assign(offsets.size(), EdgeMap());
+        std::vector<size_t> pieces;
+        size_t crossing = 0;
+        for (size_t tid = 0 ; tid < count ; tid++)
+        {
+            const Triangle& t = triangles[tid];
+            int lo = std::min(slabs[t[0]], std::min(slabs[t[1]], slabs[t[2]]));
+            int hi = std::max(slabs[t[0]], std::max(slabs[t[1]], slabs[t[2]]));
+            if (lo == hi) continue;
+            crossing++;
+
+            pieces.assign(1, tid);
+            for (int k = lo ; k < hi ; k++)
+            {
+                // Split all pieces by plane k, including the ones appended meanwhile.
+                for (size_t p = 0 ; p < pieces.size() ; )
+                {
+                    if (do_triangle(pieces[p], k)) pieces.push_back(triangles.size() - 1);
+                    else p++;
+                }
+
+                // Only keep the pieces above plane k.
+                double h = offsets[k];
+                pieces.erase(std::remove_if(pieces.begin(), pieces.end(), [&](size_t p)
+                {
+                    const Triangle& piece = triangles[p];
+                    return std::max(distances[piece[0]], std::max(distances[piece[1]], distances[piece[2]])) <= h;
+                }), pieces.end());
+            }
+        }
+        record(count, crossing, start, classified);
+    }
+
+
+
+    //
+    // Intersection polylines of the mesh with a plane.
+    // Each loop is a list of indices in points. Closed loops end with their first index again.
+    // Loops are oriented like the boundary of the part of the mesh below the plane.
+    //
+    struct Contour
+    {
+        std::vector<Vector>             points;
+        std::vector<std::vector<Index>> loops;
+    };
+
+    //
+    // Compute the intersection polylines of the mesh with each plane in planes
+    // (or with origin and normal if planes is empty), without modifying the mesh.
+    //
+    void contours(std::vector<Contour>& result) const
+    {
+        // This is a single pass over the triangles. Signed distances are computed on the fly,
+        // and only the crossing edges are stored, so the memory used besides the mesh is proportional
+        // to the size of the contours. See contours_stream for meshes that don't fit in memory.
+        //
+        // A vertex with d >= 0 counts as above the plane, so each crossing triangle has exactly
+        // two crossing edges. Following the triangle orientation, one edge goes from below to above
+        // and the other from above to below, which gives a segment between their intersection points.
+        // In an oriented manifold mesh, a crossing edge ends the segment of one of its triangles
+        // and starts the segment of the other, so segments are simply chained by edge.
+        //
+        // Planes parallel to the first one are handled together, as in cut_batch.
+        // Other planes need their own pass.
+
+        std::vector<ContourGroup> groups;
+        contour_groups(groups, result);
+        for (const ContourGroup& group : groups) group_contours(group, positions, triangles, result);
+    }
+
+    //
+    // Same as contours, for the mesh in the OBJ file input, without loading it in memory.
+    //
+    // The input is read three times, in chunks of lines. The first pass finds the slab of each vertex
+    // between the planes (as in contours), the second one keeps the faces which cross a plane,
+    // and the third one only reads the positions of their vertices. The contours of this part of the mesh
+    // are the same as the ones of contours on the whole mesh. So memory use is one int per vertex
+    // (for each group of parallel planes), plus the crossing faces and the contours.
+    // The mesh of this Slicer is cleared.
+    //
+    bool contours_stream(const std::string& input, std::vector<Contour>& result)
+    {
+        clear();
+        LineReader reader;
+        if (!reader.open(input)) return false;
+        const char* begin;
+        const char* end;
+
+        std::vector<ContourGroup> groups;
+        contour_groups(groups, result);
+
+        // Slab of each vertex, for each group.
+        std::vector<std::vector<int>> slabs(groups.size());
+        std::vector<Triangle> unused;
+        while (reader.next(begin, end))
+        {
+            positions.clear();
+            for (const char* s = begin ; s < end ; s = next_line(s, end))
+            {
+                if (record(s, end) == 'v') s = parse_line(s, end, positions, unused);
+            }
+            for (size_t g = 0 ; g < groups.size() ; g++)
+            {
+                const ContourGroup& group = groups[g];
+                for (const Vector& p : positions) slabs[g].push_back(group.slab(p));
+            }
+        }
+        const size_t vertices = slabs.empty() ? 0 : slabs[0].size();
+
+        // Keep the faces which cross a plane, and mark their vertices.
+        std::vector<bool> used(vertices, false);
+        std::vector<Triangle> chunk;
+        size_t seen = 0;
+        reader.rewind();
+        while (reader.next(begin, end))
+        {
+            chunk.clear();
+            read_faces(begin, end, seen, chunk);
+            for (const Triangle& t : chunk)
+            {
+                bool crossing = false;
+                for (const std::vector<int>& slab : slabs)
+                {
+                    int lo = std::min(slab[t[0]], std::min(slab[t[1]], slab[t[2]]));
+                    int hi = std::max(slab[t[0]], std::max(slab[t[1]], slab[t[2]]));
+                    crossing = crossing || lo < hi;
+                }
+                if (!crossing) continue;
+                triangles.push_back(t);
+                for (Index v : t) used[v] = true;
+            }
+        }
+        std::vector<std::vector<int>>().swap(slabs);
+
+        // Number the used vertices in increasing order (which keeps the order of the ends of each edge),
+        // and read their positions.
+        std::vector<Index> remap(vertices, none);
+        size_t count = 0;
+        for (size_t v = 0 ; v < vertices ; v++) if (used[v]) remap[v] = Index(count++);
+        std::vector<bool>().swap(used);
+        for (Triangle& t : triangles) for (Index& v : t) v = remap[v];
+
+        positions.clear();
+        positions.reserve(count);
+        std::vector<Vector> chunk_positions;
+        size_t v = 0;
+        reader.rewind();
+        while (reader.next(begin, end))
+        {
+            chunk_positions.clear();
+            for (const char* s = begin ; s < end ; s = next_line(s, end))
+            {
+                if (record(s, end) == 'v') s = parse_line(s, end, chunk_positions, unused);
+            }
+            for (const Vector& p : chunk_positions) if (remap[v++] != none) positions.push_back(p);
+        }
+        if (!reader.ok) return false;
+
+        for (const ContourGroup& group : groups) group_contours(group, positions, triangles, result);
+        clear();
+        return true;
+    }
+
+    //
+    // Save contours as OBJ polylines (v and l records), one group per plane.
+    //
+    bool save_contours(const std::string& filename, const std::vector<Contour>& contours) const
+    {
+        // Open the file.
+        Writer file;
+        if (!file.open(filename)) return false;
+
+        size_t first = 1;
+        for (size_t c = 0 ; c < contours.size() ; c++)
+        {
+            file.put("g plane", 7);
+            file.put_int(c);
+            file.put('\n');
+
+            // Write points.
+            for (const Vector& p : contours[c].points) file.put_vertex(p);
+
+            // Write polylines.
+            for (const std::vector<Index>& loop : contours[c].loops)
+            {
+                file.put('l');
+                for (Index i : loop) { file.put(' '); file.put_int(first + i); }
+                file.put('\n');
+            }
+            first += contours[c].points.size();
+        }
+
+        return file.close();
+    }
+
+
+
+    //
+    // Slice mesh by plane, multi-threaded version.
+    // The result is exactly the same as cut, whatever the number of threads.
+    // If threads is 0, the number of hardware threads is used.
+    //
+    void cut_parallel(unsigned threads = 0)
+    {
+        // cut processes the original triangles in order, then the triangles they appended in order,
+        // then the triangles appended by those, and so on. We call each of these rounds a generation.
+        //
+        // Within a generation, each thread splits a contiguous range of triangles.
+        // Appended triangles go to a per-thread list. Intersection vertices that are not
+        // in the intersections table yet are given temporary indices (starting after the last vertex)
+        // and recorded in the order they are encountered.
+        //
+        // The per-thread results are then merged in thread order, which is the order cut would
+        // have encountered them: new intersection vertices get their final index, temporary indices
+        // are replaced, and appended triangles are concatenated. Then the next generation starts.
+        //
+        // Intersection vertices lie on the plane, so their edges never intersect it
+        // and the temporary indices never need to be looked up.
+
+        reset_counters();
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t count = triangles.size();
+        const double start = seconds();
+        classify(threads);
+        if (robust) snap(nullptr);
+
+        // Count crossing triangles to size the intersections table.
+        std::vector<size_t> counts(threads, 0);
+        run_parallel(threads, [&](unsigned w)
+        {
+            size_t end = chunk(triangles.size(), w+1, threads);
+            for (size_t tid = chunk(triangles.size(), w, threads) ; tid < end ; tid++) counts[w] += crosses(triangles[tid]);
+        });
+        size_t crossing = 0;
+        for (size_t c : counts) crossing += c;
+        intersections.clear(crossing);
+        reserve_cut(crossing);
+
+        const double classified = seconds();
+        std::vector<Worker> workers(threads);
+        for (size_t begin = 0, end = triangles.size() ; begin < end ; begin = end, end = triangles.size())
+        {
+            // Split the triangles of this generation.
+            const Index first = positions.size();
+            run_parallel(threads, [&](unsigned w)
+            {
+                Worker& worker = workers[w];
+                worker.clear(first);
+                size_t stop = begin + chunk(end - begin, w+1, threads);
+                for (size_t tid = begin + chunk(end - begin, w, threads) ; tid < stop ; tid++)
+                {
+                    if (!crosses(triangles[tid])) continue;
+                    worker.split.push_back(tid);
+                    while (do_triangle(tid, worker));
+                }
+            });
+
+            // Give final indices to the new intersection vertices.
+            for (Worker& worker : workers)
+            {
+                worker.remap.resize(worker.edges.size());
+                for (size_t e = 0 ; e < worker.edges.size() ; e++)
+                {
+                    Index i = worker.edges[e].first, j = worker.edges[e].second;
+                    Index m = intersections.find(i, j);
+                    if (m == none)
+                    {
+                        m = positions.size();
+                        positions.push_back(worker.points[e]);
+                        distances.push_back(0);
+                        intersections.insert(i, j, m);
+                    }
+                    else if (stats)
+                    {
+                        // Created by an earlier thread.
+                        worker.hits++;
+                        worker.misses--;
+                    }
+                    worker.remap[e] = m;
+                }
+                hits    += worker.hits;
+                misses  += worker.misses;
+                retries += worker.retries;
+                worker.hits = worker.misses = worker.retries = 0;
+            }
+
+            // Replace temporary indices in split and appended triangles.
+            size_t appended = triangles.size();
+            std::vector<size_t> offsets(threads);
+            for (unsigned w = 0 ; w < threads ; w++)
+            {
+                offsets[w] = appended;
+                appended += workers[w].children.size();
+            }
+            triangles.resize(appended);
+            run_parallel(threads, [&](unsigned w)
+            {
+                Worker& worker = workers[w];
+                for (size_t tid : worker.split) worker.finalize(triangles[tid]);
+                for (size_t c = 0 ; c < worker.children.size() ; c++)
+                {
+                    worker.finalize(worker.children[c]);
+                    triangles[offsets[w] + c] = worker.children[c];
+                }
+            });
+        }
+        record(count, crossing, start, classified);
+    }
+
+
+
+private:
+
+    // Floating point arithmetic is non-exact which might
+    // cause problems when computing intersections.
+    // We fix that using a hardcoded precision value (which depends on the scalar type).
+    static constexpr double precision = SlicerTraits<Scalar>::precision();
+
+    //
+    // Hash table from edges [ij] to vertex indices.
+    // Open addressing with linear probing.
+    //
+    class EdgeMap
+    {
+    public:
+
+        // Remove all entries and make room for n entries without rehashing.
+        void clear(size_t n = 0)
+        {
+            size_t capacity = 16;
+            while (capacity < 2*n) capacity *= 2;
+            slots.assign(capacity, Slot());
+            count = 0;
+        }
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        // Return the value stored for edge [ij], or none.
+        Index find(Index i, Index j) const
+        {
+            if (slots.empty()) return none;
+            for (size_t s = hash(i, j) & (slots.size()-1) ; slots[s].i != none ; s = (s+1) & (slots.size()-1))
+            {
+                if (slots[s].i == i && slots[s].j == j) return slots[s].value;
+            }
+            return none;
+        }
+
+        // Store value for edge [ij], which must not be in the table yet.
+        void insert(Index i, Index j, Index value)
+        {
+            if (2*(count+1) > slots.size()) grow();
+            place(i, j, value);
+            count++;
+        }
+
+    private:
+
+        struct Slot
+        {
+            Index   i     = none;
+            Index   j     = none;
+            Index   value = none;
+        };
+
+        std::vector<Slot>   slots;
+        size_t              count = 0;
+
+        static size_t hash(Index i, Index j)
+        {
+            uint64_t k = uint64_t(i) * 0x9e3779b97f4a7c15ULL + uint64_t(j);
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            return size_t(k);
+        }
+
+        void place(Index i, Index j, Index value)
+        {
+            size_t s = hash(i, j) & (slots.size()-1);
+            while (slots[s].i != none) s = (s+1) & (slots.size()-1);
+            slots[s].i     = i;
+            slots[s].j     = j;
+            slots[s].value = value;
+        }
+
+        void grow()
+        {
+            std::vector<Slot> old(std::max<size_t>(16, 2*slots.size()));
+            old.swap(slots);
+            for (const Slot& slot : old) if (slot.i != none) place(slot.i, slot.j, slot.value);
+        }
+    };
+
+    // Keep track of indices of intersection points.
+    EdgeMap intersections;
+
+    // Signed distance of each vertex to the plane, computed at the start of cut.
+    std::vector<double> distances;
+
+    // Number of vertices snapped to the plane by the current cut (see robust).
+    size_t snapped = 0;
+
+    // Counters of the current cut, only updated with stats (see Stats).
+    size_t hits = 0, misses = 0, retries = 0;
+    size_t last_split = size_t(-1);     // Triangle split by the last do_triangle call, if it split one.
+
+    // Crossing triangles and the distances of their vertices, copied back from the device by cut_offload.
+    std::vector<Index>      offload_found;
+    std::vector<double>     offload_distances;
+
+    // Sorted plane offsets and intersections tables of cut_batch.
+    std::vector<double>     offsets;
+    std::vector<EdgeMap>    slab_intersections;
+
+    //
+    // Structure-of-arrays copy of positions.
+    // Vertices are only ever appended to positions during cut, so the copy
+    // is brought up to date by appending the vertices it doesn't have yet.
+    //
+    template<typename T>
+    struct Columns
+    {
+        std::vector<T> x, y, z;
+
+        const T* column(int axis) const
+        {
+            return axis == 0 ? x.data() : axis == 1 ? y.data() : z.data();
+        }
+
+        void clear()
+        {
+            x.clear();
+            y.clear();
+            z.clear();
+        }
+
+        // Drop the copies of the vertices from n on.
+        void truncate(size_t n)
+        {
+            if (x.size() <= n) return;
+            x.resize(n);
+            y.resize(n);
+            z.resize(n);
+        }
+
+        void update(const std::vector<Vector>& positions)
+        {
+            if (x.size() > positions.size()) clear();
+            x.reserve(positions.capacity());
+            y.reserve(positions.capacity());
+            z.reserve(positions.capacity());
+            for (size_t v = x.size() ; v < positions.size() ; v++)
+            {
+                x.push_back(T(positions[v][0]));
+                y.push_back(T(positions[v][1]));
+                z.push_back(T(positions[v][2]));
+            }
+        }
+    };
+
+    Columns<double> columns;
+    Columns<float>  float_columns;
+
+    //
+    // Bounding volume hierarchy over triangles, used by indexed cuts.
+    // Leaves are built with at most leaf_size triangles (sorted along the longest axis of their centroids)
+    // and hold a linked list of triangles, to which the pieces of split triangles are added.
+    //
+    class TriangleIndex
+    {
+    public:
+
+        // Scratch buffer for the triangles returned by query.
+        std::vector<Index> candidates;
+
+        void clear()
+        {
+            nodes.clear();
+            leaf_of.clear();
+            next.clear();
+            built_size = 0;
+        }
+
+        // Number of indexed triangles, and number of triangles at the last build.
+        size_t size() const  { return leaf_of.size(); }
+        size_t built() const { return built_size; }
+
+        void build(const std::vector<Vector>& positions, const std::vector<Triangle>& triangles)
+        {
+            clear();
+            size_t n = triangles.size();
+            built_size = n;
+            leaf_of.assign(n, none);
+            next.assign(n, none);
+            if (n == 0) return;
+
+            // Bounding box and centroid of each triangle.
+            std::vector<Box>   boxes(n);
+            std::vector<Vector> centers(n);
+            for (size_t tid = 0 ; tid < n ; tid++)
+            {
+                boxes[tid] = Box(positions[triangles[tid][0]]);
+                boxes[tid].add(positions[triangles[tid][1]]);
+                boxes[tid].add(positions[triangles[tid][2]]);
+                for (int a = 0 ; a < 3 ; a++) centers[tid][a] = boxes[tid].lo[a] + boxes[tid].hi[a];
+            }
+
+            std::vector<Index> order(n);
+            for (size_t tid = 0 ; tid < n ; tid++) order[tid] = Index(tid);
+            nodes.reserve(2 * (n / leaf_size + 1));
+            split(order.data(), order.data() + n, boxes, centers);
+        }
+
+        // Set out to the triangles whose bounding box might cross the plane (o, n), in no particular order.
+        void query(const Vector& o, const Vector& n, std::vector<Index>& out) const
+        {
+            out.clear();
+            if (nodes.empty()) return;
+            Index stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                const Node& node = nodes[stack[--top]];
+
+                // Signed distance of the box center to the plane, and of its corners to the center.
+                double d = 0, r = 0;
+                for (int a = 0 ; a < 3 ; a++)
+                {
+                    d += (0.5*(node.box.lo[a] + node.box.hi[a]) - o[a]) * n[a];
+                    r += 0.5*(node.box.hi[a] - node.box.lo[a]) * std::fabs(n[a]);
+                }
+                double tolerance = 1e-9 * (std::fabs(d) + r);
+                if (d - r > tolerance || d + r < -tolerance) continue;
+
+                if (node.right == none)
+                {
+                    for (Index tid = node.head ; tid != none ; tid = next[tid]) out.push_back(tid);
+                }
+                else
+                {
+                    stack[top++] = node.right;
+                    stack[top++] = node.left;
+                }
+            }
+        }
+
+        // Add the triangle at the end of the mesh to the leaf of triangle parent.
+        void add(Index parent)
+        {
+            Index tid  = Index(leaf_of.size());
+            Index leaf = leaf_of[parent];
+            leaf_of.push_back(leaf);
+            next.push_back(nodes[leaf].head);
+            nodes[leaf].head = tid;
+        }
+
+    private:
+
+        static constexpr size_t leaf_size = 8;
+
+        struct Box
+        {
+            Vector lo, hi;
+
+            Box() = default;
+            explicit Box(const Vector& p) : lo(p), hi(p) {}
+
+            void add(const Vector& p)
+            {
+                for (int a = 0 ; a < 3 ; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+
+            void add(const Box& b)
+            {
+                add(b.lo);
+                add(b.hi);
+            }
+        };
+
+        struct Node
+        {
+            Box box;
+            Index left  = none;     // Children of inner nodes,
+            Index right = none;     // or none for leaves.
+            Index head  = none;     // First triangle of leaves.
+        };
+
+        std::vector<Node>   nodes;
+        std::vector<Index>  leaf_of;    // Leaf of each triangle.
+        std::vector<Index>  next;       // Next triangle in the same leaf, or none.
+        size_t              built_size = 0;
+
+        // Build the subtree over triangles [first, last) and return its node index.
+        // Splitting at the median keeps the depth below log2(n), well within the query stack.
+        Index split(Index* first, Index* last, const std::vector<Box>& boxes, const std::vector<Vector>& centers)
+        {
+            Index id = Index(nodes.size());
+            nodes.push_back(Node());
+            Box box = boxes[*first];
+            for (Index* t = first ; t < last ; t++) box.add(boxes[*t]);
+
+            if (size_t(last - first) <= leaf_size)
+            {
+                for (Index* t = first ; t < last ; t++)
+                {
+                    leaf_of[*t] = id;
+                    next[*t] = nodes[id].head;
+                    nodes[id].head = *t;
+                }
+            }
+            else
+            {
+                Box spread(centers[*first]);
+                for (Index* t = first ; t < last ; t++) spread.add(centers[*t]);
+                int axis = 0;
+                for (int a = 1 ; a < 3 ; a++)
+                {
+                    if (spread.hi[a] - spread.lo[a] > spread.hi[axis] - spread.lo[axis]) axis = a;
+                }
+                Index* middle = first + (last - first) / 2;
+                std::nth_element(first, middle, last, [&](Index a, Index b) { return centers[a][axis] < centers[b][axis]; });
+                Index left  = split(first, middle, boxes, centers);
+                Index right = split(middle, last, boxes, centers);
+                nodes[id].left  = left;
+                nodes[id].right = right;
+            }
+            nodes[id].box = box;
+            return id;
+        }
+    };
+
+    TriangleIndex index;
+
+    //
+    // Edge table used by edge_indexed cuts.
+    // Each side of each triangle stores the index of its edge, shared with the neighbour triangle.
+    // Splitting edge [jk] at m creates its two halves [jm] and [mk], which are reused by the neighbour
+    // split at the same vertex, and the edge [im] between the two new triangles, so the table stays
+    // valid from one cut to the next. Intersection vertices are only valid for the current cut,
+    // which is given by a generation number.
+    //
+    class EdgeTable
+    {
+    public:
+
+        // Edges of each triangle [abc], in the order [ab], [bc], [ca].
+        std::vector<std::array<Index, 3>> sides;
+
+        void clear()
+        {
+            sides.clear();
+            edges.clear();
+            generation = 0;
+        }
+
+        size_t size() const
+        {
+            return sides.size();
+        }
+
+        // Number the edges of triangles, in one pass.
+        void build(const std::vector<Triangle>& triangles)
+        {
+            clear();
+            EdgeMap ids;
+            ids.clear(3 * triangles.size() / 2);
+            sides.resize(triangles.size());
+            for (size_t tid = 0 ; tid < triangles.size() ; tid++)
+            {
+                for (int n = 0 ; n < 3 ; n++)
+                {
+                    Index i = triangles[tid][n];
+                    Index j = triangles[tid][(n+1) % 3];
+                    if (i > j) std::swap(i, j);
+                    Index e = ids.find(i, j);
+                    if (e == none)
+                    {
+                        e = add();
+                        ids.insert(i, j, e);
+                    }
+                    sides[tid][n] = e;
+                }
+            }
+        }
+
+        // Start a new cut, forgetting all intersection vertices.
+        void begin()
+        {
+            generation++;
+        }
+
+        // Intersection vertex of edge e in this cut, or none.
+        Index vertex(Index e) const
+        {
+            return edges[e].generation == generation ? edges[e].vertex : none;
+        }
+
+        // Half of edge e (split in this cut) on the side of its lower (0) or higher (1) vertex index.
+        Index half(Index e, int side) const
+        {
+            return edges[e].halves[side];
+        }
+
+        // Record vertex m as the intersection on edge e, and create the halves of e.
+        void split(Index e, Index m)
+        {
+            Index low  = add();
+            Index high = add();
+            Edge& edge = edges[e];
+            edge.generation = generation;
+            edge.vertex     = m;
+            edge.halves     = {{ low, high }};
+        }
+
+        // Add a new edge and return its index.
+        Index add()
+        {
+            edges.push_back(Edge());
+            return Index(edges.size() - 1);
+        }
+
+    private:
+
+        struct Edge
+        {
+            unsigned                generation = 0;
+            Index                   vertex     = none;
+            std::array<Index, 2>    halves     = {{ none, none }};
+        };
+
+        std::vector<Edge>   edges;
+        unsigned            generation = 0;
+    };
+
+    EdgeTable edge_table;
+
+    // True while cut splits triangles with edge_table, which other cuts may have left out of date.
+    bool edge_cut = false;
+
+    //
+    // get_intersection and do_triangle for the cut of a MeshView, with output triangles stored in output.indices.
+    // Vertex v comes from the view if v < vertex_count, and from output.positions otherwise.
+    //
+    template<typename ViewScalar, typename ViewIndex>
+    struct ViewCut
+    {
+        const MeshView<ViewScalar, ViewIndex>&  mesh;
+        MeshOutput<ViewScalar, ViewIndex>&      output;
+        std::vector<double>&                    distances;
+        EdgeMap&                                intersections;
+
+        const ViewScalar* position(size_t v) const
+        {
+            return v < mesh.vertex_count ? mesh.positions + 3*v : output.positions.data() + 3*(v - mesh.vertex_count);
+        }
+
+        bool crosses(size_t tid) const
+        {
+            const ViewIndex* t = output.indices.data() + 3*tid;
+            double a = distances[t[0]], b = distances[t[1]], c = distances[t[2]];
+            return std::min(a, std::min(b, c)) < 0 && std::max(a, std::max(b, c)) > 0;
+        }
+
+        Index get_intersection(Index i, Index j)
+        {
+            if (i > j) std::swap(i, j);
+
+            double lambda = distances[j] / (distances[j] - distances[i]);
+            if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+            Index found = intersections.find(i, j);
+            if (found != none) return found;
+
+            Index m = distances.size();
+            distances.push_back(0);
+            for (int a = 0 ; a < 3 ; a++)
+            {
+                double p = position(i)[a], q = position(j)[a];
+                output.positions.push_back(ViewScalar(lambda*p + (1-lambda)*q));
+            }
+            intersections.insert(i, j, m);
+            return m;
+        }
+
+        bool do_triangle(size_t tid)
+        {
+            for (int n=0 ; n<3 ; n++)
+            {
+                Index i = Index(output.indices[3*tid + n]);
+                Index j = Index(output.indices[3*tid + (n+1) % 3]);
+                Index k = Index(output.indices[3*tid + (n+2) % 3]);
+
+                Index m = get_intersection(j, k);
+                if (m != none)
+                {
+                    output.indices.push_back(ViewIndex(i));
+                    output.indices.push_back(ViewIndex(j));
+                    output.indices.push_back(ViewIndex(m));
+                    ViewIndex* t = output.indices.data() + 3*tid;
+                    t[0] = ViewIndex(i);
+                    t[1] = ViewIndex(m);
+                    t[2] = ViewIndex(k);
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+
+
+    //
+    // Read-only view of a whole file.
+    // The file is memory-mapped when possible, and read into a buffer otherwise.
+    //
+    struct MappedFile
+    {
+        const char*         data = nullptr;
+        size_t              size = 0;
+        std::vector<char>   buffer;
+        #if SLICER_MMAP
+        void*               mapping = nullptr;
+        #endif
+
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& filename)
+        {
+            #if SLICER_MMAP
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+            size = st.st_size;
+            if (size > 0)
+            {
+                mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) { mapping = nullptr; ::close(fd); return false; }
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(mapping);
+            }
+            ::close(fd);
+            return true;
+            #else
+            std::ifstream file(filename, std::ios::binary);
+            if (!file) return false;
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data = buffer.data();
+            size = buffer.size();
+            return true;
+            #endif
+        }
+
+        ~MappedFile()
+        {
+            #if SLICER_MMAP
+            if (mapping) munmap(mapping, size);
+            #endif
+        }
+    };
+
+
+
+    //
+    // Header of binary mesh files.
+    //
+    struct BinaryHeader
+    {
+        char        magic[4]        = { 'M', 'M', 'S', 'B' };
+        uint32_t    version         = 1;
+        uint32_t    scalar_size     = sizeof(Scalar);
+        uint32_t    index_size      = sizeof(Index);
+        uint64_t    vertex_count    = 0;
+        uint64_t    triangle_count  = 0;
+
+        bool valid() const
+        {
+            BinaryHeader expected;
+            return std::memcmp(magic, expected.magic, sizeof(magic)) == 0
+                && version     == expected.version
+                && scalar_size == expected.scalar_size
+                && index_size  == expected.index_size;
+        }
+    };
+
+
+
+    //
+    // Queue of at most capacity items between two threads.
+    // push waits while the queue is full, and pop waits while it is empty.
+    // After close, pop returns false once the queue is empty.
+    //
+    template<typename T>
+    struct BoundedQueue
+    {
+        std::mutex              mutex;
+        std::condition_variable not_empty, not_full;
+        std::deque<T>           items;
+        size_t                  capacity;
+        bool                    closed = false;
+
+        explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+        void push(T&& item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [&] { return items.size() < capacity; });
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+        }
+
+        bool pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [&] { return !items.empty() || closed; });
+            if (items.empty()) return false;
+            item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            not_empty.notify_all();
+        }
+    };
+
+    //
+    // Split chunk of faces passed to the writer of cut_pipelined, with the vertices it created.
+    //
+    struct Piece
+    {
+        std::vector<Vector>   vertices;
+        std::vector<Triangle> triangles;
+    };
+
+
+
+    //
+    // Input file read in chunks of whole lines.
+    //
+    struct LineReader
+    {
+        std::FILE*          file = nullptr;
+        std::vector<char>   buffer;
+        size_t              size = 0;       // Number of bytes in buffer.
+        size_t              used = 0;       // Number of bytes already returned by next.
+        bool                ok   = true;
+
+        LineReader() = default;
+        LineReader(const LineReader&) = delete;
+        LineReader& operator=(const LineReader&) = delete;
+
+        bool open(const std::string& filename, size_t capacity = 1 << 20)
+        {
+            file = std::fopen(filename.c_str(), "rb");
+            if (!file) return false;
+            buffer.resize(capacity);
+            size = used = 0;
+            return ok = true;
+        }
+
+        void rewind()
+        {
+            std::rewind(file);
+            size = used = 0;
+        }
+
+        // Set [first, last) to the next chunk of whole lines, and return false at the end of the file.
+        // The buffer grows if a single line doesn't fit.
+        bool next(const char*& first, const char*& last)
+        {
+            // Move the incomplete last line of the previous chunk to the front.
+            std::memmove(buffer.data(), buffer.data() + used, size - used);
+            size -= used;
+            used = 0;
+
+            for (;;)
+            {
+                if (size == buffer.size()) buffer.resize(2 * buffer.size());
+                size_t n = std::fread(buffer.data() + size, 1, buffer.size() - size, file);
+                if (n == 0 && std::ferror(file)) ok = false;
+                size += n;
+
+                // Stop after the last complete line, or at the end of the file.
+                size_t end = size;
+                while (end > 0 && buffer[end-1] != '\n') end--;
+                if (n == 0) end = size;
+                if (end == 0 && n != 0) continue;
+                if (end == 0) return false;
+
+                first = buffer.data();
+                last  = buffer.data() + end;
+                used  = end;
+                return true;
+            }
+        }
+
+        ~LineReader()
+        {
+            if (file) std::fclose(file);
+        }
+    };
+
+    //
+    // First pass of cut_stream and cut_pipelined: clear the mesh, open input with reader and read all its vertices.
+    //
+    bool read_vertices(const std::string& input, LineReader& reader)
+    {
+        clear();
+        if (!reader.open(input)) return false;
+        const char* begin;
+        const char* end;
+        std::vector<Triangle> no_faces;
+        while (reader.next(begin, end))
+        {
+            for (const char* s = begin ; s < end ; s = next_line(s, end))
+            {
+                if (record(s, end) == 'v') s = parse_line(s, end, positions, no_faces);
+            }
+        }
+        return reader.ok;
+    }
+
+    //
+    // Append the triangles of the faces in the chunk of lines [begin, end) to chunk, for the second pass
+    // of the stream cuts. seen is the number of vertices in the previous chunks, for relative indices.
+    //
+    static void read_faces(const char* begin, const char* end, size_t& seen, std::vector<Triangle>& chunk)
+    {
+        for (const char* s = begin ; s < end ; s = next_line(s, end))
+        {
+            char type = record(s, end);
+            if      (type == 'v') seen++;
+            else if (type == 'f') s = parse_face(s+1, end, seen, chunk);
+        }
+    }
+
+
+
+    //
+    // Buffered output file.
+    // Text is accumulated in a large buffer which is written with a single call when full.
+    //
+    struct Writer
+    {
+        static constexpr size_t capacity = 1 << 20;
+
+        std::FILE*          file = nullptr;
+        std::vector<char>   buffer;
+        size_t              used = 0;
+        bool                ok   = true;
+
+        Writer() = default;
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool open(const std::string& filename)
+        {
+            file = std::fopen(filename.c_str(), "wb");
+            if (!file) return false;
+            std::setvbuf(file, nullptr, _IONBF, 0);
+            buffer.resize(capacity);
+            used = 0;
+            return ok = true;
+        }
+
+        void flush()
+        {
+            if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) ok = false;
+            used = 0;
+        }
+
+        bool close()
+        {
+            if (!file) return false;
+            flush();
+            if (std::fclose(file) != 0) ok = false;
+            file = nullptr;
+            return ok;
+        }
+
+        ~Writer()
+        {
+            if (file) close();
+        }
+
+        // Make room for at least n characters and return where to write them.
+        char* reserve(size_t n)
+        {
+            if (used + n > capacity) flush();
+            return buffer.data() + used;
+        }
+
+        void put(char c)
+        {
+            *reserve(1) = c;
+            used++;
+        }
+
+        void put(const char* s, size_t n)
+        {
+            if (n > capacity) { flush(); if (std::fwrite(s, 1, n, file) != n) ok = false; return; }
+            std::memcpy(reserve(n), s, n);
+            used += n;
+        }
+
+        void put_int(long long value)
+        {
+            char* s = reserve(24);
+            unsigned long long n = value < 0 ? 0ull - value : value;
+            if (value < 0) *s++ = '-';
+            char digits[24];
+            int count = 0;
+            do { digits[count++] = char('0' + n % 10); n /= 10; } while (n);
+            while (count) *s++ = digits[--count];
+            used = s - buffer.data();
+        }
+
+        // Write the shortest form of value that reads back exactly as the same type.
+        void put_number(double value)
+        {
+            char* s = reserve(32);
+            used += format_double(s, value);
+        }
+
+        void put_number(float value)
+        {
+            char* s = reserve(32);
+            used += format_float(s, value);
+        }
+
+        // Write "v x y z" and "f i j k" records (with 1-based indices).
+        void put_vertex(const Vector& p)
+        {
+            put("v ", 2);
+            put_number(p[0]); put(' ');
+            put_number(p[1]); put(' ');
+            put_number(p[2]); put('\n');
+        }
+
+        void put_triangle(const Triangle& t)
+        {
+            put("f ", 2);
+            put_int(t[0] + 1); put(' ');
+            put_int(t[1] + 1); put(' ');
+            put_int(t[2] + 1); put('\n');
+        }
+    };
+
+    //
+    // Write the shortest decimal representation of value that reads back exactly.
+    // Returns the number of characters written (at most 32).
+    //
+    static size_t format_double(char* s, double value)
+    {
+        #if SLICER_TO_CHARS
+        return std::to_chars(s, s + 32, value).ptr - s;
+        #else
+        for (int digits = 15 ; ; digits++)
+        {
+            int n = std::snprintf(s, 32, "%.*g", digits, value);
+            if (digits == 17 || std::strtod(s, nullptr) == value) return n;
+        }
+        #endif
+    }
+
+    //
+    // Same as format_double, for a value read back as a float.
+    //
+    static size_t format_float(char* s, float value)
+    {
+        #if SLICER_TO_CHARS
+        return std::to_chars(s, s + 32, value).ptr - s;
+        #else
+        for (int digits = 6 ; ; digits++)
+        {
+            int n = std::snprintf(s, 32, "%.*g", digits, double(value));
+            if (digits == 9 || std::strtof(s, nullptr) == value) return n;
+        }
+        #endif
+    }
+
+
+
+    //
+    // Hand-written scanner used by the fast OBJ loaders.
+    // All functions take the current position and the end of the buffer,
+    // and return the position after what they have read.
+    //
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char* skip_spaces(const char* s, const char* end)
+    {
+        while (s < end && is_space(*s)) s++;
+        return s;
+    }
+
+    static const char* skip_token(const char* s, const char* end)
+    {
+        while (s < end && !is_space(*s) && *s != '\n') s++;
+        return s;
+    }
+
+    static const char* next_line(const char* s, const char* end)
+    {
+        const char* eol = static_cast<const char*>(memchr(s, '\n', end - s));
+        return eol ? eol + 1 : end;
+    }
+
+    template<typename Integer>
+    static const char* parse_int(const char* s, const char* end, Integer& value)
+    {
+        s = skip_spaces(s, end);
+        bool negative = (s < end && *s == '-');
+        if (s < end && (*s == '-' || *s == '+')) s++;
+        Integer n = 0;
+        while (s < end && unsigned(*s - '0') < 10) n = 10*n + Integer(*s++ - '0');
+        value = negative ? Integer(0) - n : n;
+        return skip_token(s, end);
+    }
+
+    static const char* parse_double(const char* s, const char* end, double& value)
+    {
+        // Powers of ten that are exactly representable as doubles.
+        static const double exact[] =
+        {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        s = skip_spaces(s, end);
+        const char* token = s;
+
+        // Read sign, digits and exponent.
+        bool negative = (s < end && *s == '-');
+        if (s < end && (*s == '-' || *s == '+')) s++;
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        for ( ; s < end && unsigned(*s - '0') < 10 ; s++)
+        {
+            if (digits < 19) { mantissa = 10*mantissa + (*s - '0'); digits += (mantissa != 0); }
+            else exponent++;
+        }
+        if (s < end && *s == '.')
+        {
+            for (s++ ; s < end && unsigned(*s - '0') < 10 ; s++)
+            {
+                if (digits < 19) { mantissa = 10*mantissa + (*s - '0'); digits += (mantissa != 0); exponent--; }
+            }
+        }
+        if (s < end && (*s == 'e' || *s == 'E'))
+        {
+            int e;
+            s = parse_int(s+1, end, e);
+            exponent += e;
+        }
+
+        // If the mantissa and the power of ten are exact, a single multiplication
+        // or division gives the correctly rounded result. Otherwise use strtod.
+        if (digits <= 15 && exponent >= -22 && exponent <= 22 && (s == end || is_space(*s) || *s == '\n'))
+        {
+            value = exponent < 0 ? mantissa / exact[-exponent] : mantissa * exact[exponent];
+            if (negative) value = -value;
+            return s;
+        }
+        // The token is copied to the stack for strtod, except absurdly long ones.
+        s = skip_token(token, end);
+        char copy[64];
+        size_t length = s - token;
+        if (length < sizeof(copy))
+        {
+            std::memcpy(copy, token, length);
+            copy[length] = 0;
+            value = std::strtod(copy, nullptr);
+        }
+        else value = std::strtod(std::string(token, s).c_str(), nullptr);
+        return s;
+    }
+
+    //
+    // Skip leading spaces and return the type of the OBJ record starting at s:
+    // 'v' for a vertex, 'f' for a face, and 0 for anything else.
+    //
+    static char record(const char*& s, const char* end)
+    {
+        s = skip_spaces(s, end);
+        if (end - s < 2 || !is_space(s[1]) || (s[0] != 'v' && s[0] != 'f')) return 0;
+        return s[0];
+    }
+
+    //
+    // Parse one OBJ line, and append the vertex or triangles it contains (if any).
+    // Returns the position after the line content. See parse_face for relative.
+    //
+    static const char* parse_line(const char* s, const char* end, std::vector<Vector>& positions, std::vector<Triangle>& triangles,
+                                  std::vector<size_t>* relative = nullptr)
+    {
+        char type = record(s, end);
+
+        // If vertex.
+        if (type == 'v')
+        {
+            double x, y, z;
+            s = parse_double(s+1, end, x);
+            s = parse_double(s,   end, y);
+            s = parse_double(s,   end, z);
+            positions.push_back({{ Scalar(x), Scalar(y), Scalar(z) }});
+        }
+
+        // If face.
+        else if (type == 'f')
+        {
+            s = parse_face(s+1, end, positions.size(), triangles, relative);
+        }
+
+        return s;
+    }
+
+    //
+    // Parse the vertex indices of a face record "f i j k ..." (from after the 'f'), and append its triangles:
+    // a polygon with n vertices is split into a fan of n-2 triangles around its first vertex.
+    // Each index may be followed by texture and normal indices (i/t, i/t/n or i//n), which are ignored.
+    // Negative indices count back from the last of the vertices read so far, of which there are count.
+    // If relative is not null, the position 3*triangle+corner of each relative index is appended to it
+    // (triangle being its index in triangles), so that the loader can shift them when count was local.
+    //
+    static const char* parse_face(const char* s, const char* end, size_t count, std::vector<Triangle>& triangles,
+                                  std::vector<size_t>* relative = nullptr)
+    {
+        // The first triangle, as parsed for plain triangle faces.
+        long long i[3];
+        s = parse_int(s, end, i[0]);
+        s = parse_int(s, end, i[1]);
+        s = parse_int(s, end, i[2]);
+        Triangle t;
+        for (int k = 0 ; k < 3 ; k++) t[k] = i[k] < 0 ? Index(count + i[k]) : Index(i[k] - 1);
+        if (relative && (i[0] | i[1] | i[2]) < 0)
+        {
+            for (int k = 0 ; k < 3 ; k++) if (i[k] < 0) relative->push_back(3 * triangles.size() + k);
+        }
+        triangles.push_back(t);
+
+        // Any further vertex adds the triangle made with the first vertex and the previous one.
+        for (;;)
+        {
+            s = skip_spaces(s, end);
+            if (s == end || !(*s == '-' || *s == '+' || unsigned(*s - '0') < 10)) return s;
+
+            i[1] = i[2];
+            t[1] = t[2];
+            s = parse_int(s, end, i[2]);
+            t[2] = i[2] < 0 ? Index(count + i[2]) : Index(i[2] - 1);
+            if (relative && (i[0] | i[1] | i[2]) < 0)
+            {
+                for (int k = 0 ; k < 3 ; k++) if (i[k] < 0) relative->push_back(3 * triangles.size() + k);
+            }
+            triangles.push_back(t);
+        }
+    }
+
+    //
+    // Parse all lines in [begin, end), which must start at a line boundary.
+    // A quick first pass counts the vertices and triangles so that the arrays are only allocated once.
+    //
+    static void parse_chunk(const char* begin, const char* end, std::vector<Vector>& positions, std::vector<Triangle>& triangles,
+                            std::vector<size_t>* relative = nullptr)
+    {
+        // Count vertices and triangles.
+        size_t nv = 0, nt = 0;
+        for (const char* s = begin ; s < end ; s = next_line(s, end))
+        {
+            char type = record(s, end);
+            nv += (type == 'v');
+            nt += (type == 'f');
+        }
+        positions.reserve(positions.size() + nv);
+        triangles.reserve(triangles.size() + nt);
+
+        // Parse vertices and triangles.
+        for (const char* s = begin ; s < end ; s = next_line(s, end))
+        {
+            s = parse_line(s, end, positions, triangles, relative);
+        }
+    }
+
+
+
+    //
+    // Start of the w-th of threads chunks of a range of size n.
+    //
+    static size_t chunk(size_t n, unsigned w, unsigned threads)
+    {
+        return n / threads * w + n % threads * w / threads;
+    }
+
+    //
+    // Run function(0), ..., function(threads-1) in parallel and wait for all of them.
+    //
+    template<typename Function>
+    static void run_parallel(unsigned threads, Function function)
+    {
+        std::vector<std::thread> pool;
+        for (unsigned w = 1 ; w < threads ; w++) pool.emplace_back(function, w);
+        function(0);
+        for (std::thread& t : pool) t.join();
+    }
+
+
+
+    //
+    // Same as cut, with the classification offloaded to OpenMP device (see offload).
+    //
+    // The device computes the signed distances of all vertices, counts the crossing triangles, then
+    // compacts them: each one takes the next slot of the output arrays (with an atomic counter) for its index
+    // and the distances of its vertices. The crossing triangles are then sorted, and split in the order of cut.
+    // The distances of the other vertices are not copied back (as in cut_indexed).
+    // Returns false, without changing the mesh, if the device memory can't be allocated.
+    //
+    bool cut_offload(int device)
+    {
+        #if SLICER_OFFLOAD
+        const size_t vertices = positions.size(), count = triangles.size();
+        if (vertices == 0 || count == 0) return false;
+        const double start = seconds();
+
+        const Scalar* p = positions[0].data();
+        const Index*  t = triangles[0].data();
+        double* d = static_cast<double*>(omp_target_alloc(vertices * sizeof(double), device));
+        if (!d) return false;
+
+        const int    axis   = aligned_axis(normal);
+        const bool   single = float_classify;
+        const double o0 = origin[0], o1 = origin[1], o2 = origin[2];
+        const double n0 = normal[0], n1 = normal[1], n2 = normal[2];
+        const double oa = axis != -1 ? origin[axis] : 0, na = axis != -1 ? normal[axis] : 0;
+
+        size_t crossing = 0, next = 0;
+        std::vector<Index>&  found = offload_found;
+        std::vector<double>& found_distances = offload_distances;
+        #pragma omp target data map(to: p[0:3*vertices], t[0:3*count]) device(device)
+        {
+            // Same expressions as classify_range (without SIMD).
+            #pragma omp target teams distribute parallel for is_device_ptr(d) device(device)
+            for (size_t v = 0 ; v < vertices ; v++)
+            {
+                const Scalar* q = p + 3*v;
+                if (axis != -1 && single) d[v] = (float(q[axis]) - float(oa)) * float(na);
+                else if (axis != -1)      d[v] = (double(q[axis]) - oa) * na;
+                else if (single)          d[v] = (float(q[0]) - float(o0)) * float(n0)
+                                               + (float(q[1]) - float(o1)) * float(n1)
+                                               + (float(q[2]) - float(o2)) * float(n2);
+                else                      d[v] = (double(q[0]) - o0) * n0
+                                               + (double(q[1]) - o1) * n1
+                                               + (double(q[2]) - o2) * n2;
+            }
+
+            #pragma omp target teams distribute parallel for reduction(+:crossing) is_device_ptr(d) device(device)
+            for (size_t k = 0 ; k < count ; k++)
+            {
+                double a = d[t[3*k]], b = d[t[3*k+1]], c = d[t[3*k+2]];
+                crossing += ((a < 0 || b < 0 || c < 0) && (a > 0 || b > 0 || c > 0));
+            }
+
+            found.resize(crossing);
+            found_distances.resize(3*crossing);
+            Index*  f = found.data();
+            double* e = found_distances.data();
+            if (crossing > 0)
+            {
+                #pragma omp target teams distribute parallel for is_device_ptr(d) map(tofrom: next) \
+                                                                 map(from: f[0:crossing], e[0:3*crossing]) device(device)
+                for (size_t k = 0 ; k < count ; k++)
+                {
+                    double a = d[t[3*k]], b = d[t[3*k+1]], c = d[t[3*k+2]];
+                    if (!((a < 0 || b < 0 || c < 0) && (a > 0 || b > 0 || c > 0))) continue;
+                    size_t slot;
+                    #pragma omp atomic capture
+                    slot = next++;
+                    f[slot] = Index(k);
+                    e[3*slot] = a;
+                    e[3*slot+1] = b;
+                    e[3*slot+2] = c;
+                }
+            }
+        }
+        omp_target_free(d, device);
+
+        distances.resize(vertices);
+        for (size_t k = 0 ; k < crossing ; k++)
+        {
+            for (int n = 0 ; n < 3 ; n++) distances[triangles[found[k]][n]] = found_distances[3*k+n];
+        }
+        std::sort(found.begin(), found.end());
+        intersections.clear(crossing);
+        reserve_cut(crossing);
+
+        const double classified = seconds();
+        for (Index tid : found)
+        {
+            while (crosses(triangles[tid]) && do_triangle(tid)) {}
+        }
+        split(count);
+        record(count, crossing, start, classified);
+        return true;
+        #else
+        (void)device;
+        return false;
+        #endif
+    }
+
+    //
+    // Default OpenMP device of cut_offload.
+    //
+    static int omp_device()
+    {
+        #if SLICER_OFFLOAD
+        return omp_get_default_device();
+        #else
+        return 0;
+        #endif
+    }
+
+    //
+    // Same as cut, visiting only the triangles whose bounding box crosses the plane.
+    //
+    // The candidates are processed in increasing order, followed by the appended triangles,
+    // which is the order of cut since the other triangles don't cross the plane.
+    // Only the distances of the candidate vertices are computed. Triangles appended by do_triangle
+    // are pieces of their parent, so they are added to the leaf of their parent, whose box contains them.
+    //
+    void cut_indexed()
+    {
+        const size_t count = triangles.size();
+        const double start = seconds();
+        if (index.size() != triangles.size() || index.size() > 2*index.built()) index.build(positions, triangles);
+
+        std::vector<Index>& candidates = index.candidates;
+        index.query(origin, normal, candidates);
+        std::sort(candidates.begin(), candidates.end());
+
+        distances.resize(positions.size());
+        if (soa && float_classify) float_columns.update(positions);
+        else if (soa)              columns.update(positions);
+
+        for (Index tid : candidates)
+        {
+            for (Index v : triangles[tid]) classify_range(v, v+1);
+        }
+        if (robust) snap(&candidates);
+        size_t crossing = 0;
+        for (Index tid : candidates) crossing += crosses(triangles[tid]);
+        intersections.clear(crossing);
+        reserve_cut(crossing);
+
+        const double classified = seconds();
+        size_t first = triangles.size();
+        for (Index tid : candidates)
+        {
+            while (crosses(triangles[tid]) && do_triangle(tid)) index.add(Index(tid));
+        }
+        for (size_t tid = first ; tid < triangles.size() ; tid++)
+        {
+            while (crosses(triangles[tid]) && do_triangle(tid)) index.add(Index(tid));
+        }
+        record(count, crossing, start, classified);
+    }
+
+    //
+    // Tell if triangle t is above the plane, for separate.
+    //
+    bool above(const Triangle& t) const
+    {
+        double d = distances[t[0]];
+        for (int n = 1 ; n < 3 ; n++)
+        {
+            if (std::fabs(distances[t[n]]) > std::fabs(d)) d = distances[t[n]];
+        }
+        return d > 0;
+    }
+
+    //
+    // Set half to the triangles above the plane (side 1) or below it (side 0), with their vertices.
+    // After reorder, the triangles are visited in their original order, as save writes them,
+    // so that the halves are the same as without reorder.
+    //
+    void extract(int side, BasicSlicer& half) const
+    {
+        half.clear();
+        std::vector<size_t> order(triangles.size());
+        for (size_t tid = 0 ; tid < triangles.size() ; tid++)
+        {
+            order[tid < original_triangles.size() ? size_t(original_triangles[tid]) : tid] = tid;
+        }
+        std::vector<Index> remap(positions.size(), none);
+        for (size_t tid : order)
+        {
+            const Triangle& t = triangles[tid];
+            if (int(above(t)) != side) continue;
+            Triangle r;
+            for (int n = 0 ; n < 3 ; n++)
+            {
+                Index& v = remap[t[n]];
+                if (v == none)
+                {
+                    v = half.positions.size();
+                    half.positions.push_back(positions[t[n]]);
+                }
+                r[n] = v;
+            }
+            half.triangles.push_back(r);
+        }
+    }
+
+    //
+    // Current time in seconds, only read when stats are enabled.
+    //
+    double seconds() const
+    {
+        return stats ? std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() : 0;
+    }
+
+    //
+    // Fill stats at the end of a cut, given the number of triangles and times at the start and after classification.
+    //
+    void record(size_t count, size_t crossing, double start, double classified)
+    {
+        if (!stats) return;
+        stats->classify_seconds = classified - start;
+        stats->split_seconds    = seconds() - classified;
+        stats->crossing         = crossing;
+        stats->splits           = triangles.size() - count;
+        stats->retries          = retries;
+        stats->hits             = hits;
+        stats->misses           = misses;
+        stats->snapped          = snapped;
+    }
+
+    //
+    // Forget the counters of the previous cut, at the start of every cut
+    // (cut_stream and cut_pipelined count lookups, but don't record them).
+    //
+    void reset_counters()
+    {
+        snapped = hits = misses = retries = 0;
+        last_split = size_t(-1);
+    }
+
+    //
+    // Robust classification of the vertices of the candidate triangles, or of all triangles if candidates is null (see robust).
+    //
+    // Snapping only sets distances to zero, which makes edges stop crossing the plane but never start.
+    // So after a single pass over the edges, every edge which still crosses the plane is cut within
+    // [precision, 1-precision], and do_triangle succeeds on every crossing triangle and its pieces.
+    //
+    void snap(const std::vector<Index>* candidates)
+    {
+        // Exact sides of the vertices within rounding error of the plane.
+        double epsilon = float_classify ? std::numeric_limits<float>::epsilon() : std::numeric_limits<double>::epsilon();
+        auto side = [&](Index v)
+        {
+            const Vector& p = positions[v];
+            double& d = distances[v];
+            double bound = 0;
+            for (int a = 0 ; a < 3 ; a++) bound += (std::fabs(double(p[a])) + std::fabs(double(origin[a]))) * std::fabs(double(normal[a]));
+            if (std::fabs(d) > 4 * epsilon * bound) return;
+            int s = exact_side(p, origin, normal);
+            if (s == 0 || (d > 0) != (s > 0)) d = 0;
+        };
+        if (candidates) for (Index tid : *candidates) for (Index v : triangles[tid]) side(v);
+        else            for (size_t v = 0 ; v < positions.size() ; v++) side(Index(v));
+
+        // Snap the vertices where a crossing edge would be cut too close to them.
+        size_t count = candidates ? candidates->size() : triangles.size();
+        for (size_t c = 0 ; c < count ; c++)
+        {
+            const Triangle& t = triangles[candidates ? size_t((*candidates)[c]) : c];
+            for (int n = 0 ; n < 3 ; n++)
+            {
+                Index i = t[n], j = t[(n+1) % 3];
+                if (i > j) std::swap(i, j);
+                double di = distances[i], dj = distances[j];
+                if (!((di < 0 && dj > 0) || (di > 0 && dj < 0))) continue;
+                double lambda = dj / (dj - di);
+                if      (lambda < precision)     { distances[j] = 0; snapped++; }
+                else if (lambda > 1 - precision) { distances[i] = 0; snapped++; }
+            }
+        }
+    }
+
+    //
+    // Exact sign of the signed distance of p to the plane (o, n).
+    // Each term (p[a] - o[a]) * n[a] is the exact sum of four doubles (with two_sum and two_product),
+    // and the twelve are accumulated into a nonoverlapping expansion (as in Shewchuk's predicates),
+    // whose sign is the sign of its largest component.
+    //
+    static int exact_side(const Vector& p, const Vector& o, const Vector& n)
+    {
+        double expansion[12];
+        int size = 0;
+        for (int a = 0 ; a < 3 ; a++)
+        {
+            double s, e, terms[4];
+            two_sum(double(p[a]), -double(o[a]), s, e);
+            two_product(s, double(n[a]), terms[0], terms[1]);
+            two_product(e, double(n[a]), terms[2], terms[3]);
+            for (double term : terms) size = grow_expansion(expansion, size, term);
+        }
+        for (int k = size - 1 ; k >= 0 ; k--)
+        {
+            if (expansion[k] != 0) return expansion[k] > 0 ? 1 : -1;
+        }
+        return 0;
+    }
+
+    // a + b = sum + error exactly.
+    static void two_sum(double a, double b, double& sum, double& error)
+    {
+        sum = a + b;
+        double bb = sum - a;
+        error = (a - (sum - bb)) + (b - bb);
+    }
+
+    // a * b = product + error exactly (barring underflow).
+    static void two_product(double a, double b, double& product, double& error)
+    {
+        product = a * b;
+        error = std::fma(a, b, -product);
+    }
+
+    // Add b to the expansion e of size components (in increasing magnitude, without zeros), and return its new size.
+    static int grow_expansion(double* e, int size, double b)
+    {
+        int count = 0;
+        double q = b;
+        for (int k = 0 ; k < size ; k++)
+        {
+            double sum, error;
+            two_sum(q, e[k], sum, error);
+            q = sum;
+            if (error != 0) e[count++] = error;
+        }
+        if (q != 0) e[count++] = q;
+        return count;
+    }
+
+    //
+    // Spread the 21 low bits of x to every third bit, for Morton codes.
+    //
+    static uint64_t interleave(uint64_t x)
+    {
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffULL;
+        x = (x | x << 16) & 0x1f0000ff0000ffULL;
+        x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+        x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+        x = (x | x << 2)  & 0x1249249249249249ULL;
+        return x;
+    }
+
+    //
+    // If the mesh was reordered, set p and t to the mesh in its original order and return true.
+    // Vertices and triangles appended since then keep their place at the end.
+    //
+    bool restore(std::vector<Vector>& p, std::vector<Triangle>& t) const
+    {
+        if (original_vertices.empty() && original_triangles.empty()) return false;
+        p.resize(positions.size());
+        t.resize(triangles.size());
+        auto original = [&](Index v) { return size_t(v) < original_vertices.size() ? original_vertices[v] : v; };
+        for (size_t v = 0 ; v < positions.size() ; v++) p[original(Index(v))] = positions[v];
+        for (size_t tid = 0 ; tid < triangles.size() ; tid++)
+        {
+            Triangle& r = t[tid < original_triangles.size() ? size_t(original_triangles[tid]) : tid];
+            for (int c = 0 ; c < 3 ; c++) r[c] = original(triangles[tid][c]);
+        }
+        return true;
+    }
+
+    //
+    // Make room for the output of a cut crossing the given number of triangles, so that
+    // the mesh arrays are reallocated at most once during the cut.
+    //
+    // A crossing triangle is split into at most three pieces, and has at most two new vertices,
+    // so the mesh grows by at most 2 triangles and 2 vertices per crossing triangle.
+    //
+    void reserve_cut(size_t crossing)
+    {
+        reserve_extra(triangles, 2*crossing);
+        reserve_extra(positions, 2*crossing);
+        reserve_extra(distances, 2*crossing);
+    }
+
+    // Make room for extra more elements in v. Some slack is kept so that repeated cuts
+    // of the same mesh don't reallocate it every time.
+    template<typename T>
+    static void reserve_extra(std::vector<T>& v, size_t extra)
+    {
+        size_t needed = v.size() + extra;
+        if (needed > v.capacity()) v.reserve(std::max(needed, v.capacity() + v.capacity() / 8));
+    }
+
+    //
+    // Main loop of cut, over the triangles from first to the end of the mesh.
+    //
+    void split(size_t first)
+    {
+        for (size_t tid = first ; tid < triangles.size() ; )
+        {
+            if (!crosses(triangles[tid])) tid++;
+            else tid += !do_triangle(tid);
+        }
+    }
+
+    //
+    // Compute the signed distance of each vertex to the plane (in units of the normal length).
+    //
+    void classify(unsigned threads = 1)
+    {
+        distances.resize(positions.size());
+        if (soa && float_classify) float_columns.update(positions);
+        else if (soa)              columns.update(positions);
+
+        run_parallel(threads, [&](unsigned w)
+        {
+            size_t begin = chunk(positions.size(), w, threads);
+            size_t end   = chunk(positions.size(), w+1, threads);
+            classify_range(begin, end);
+        });
+    }
+
+    void classify_range(size_t begin, size_t end)
+    {
+        // Axis-aligned planes only need one coordinate of each vertex,
+        // and give the same distances as the full dot product (the other terms are zero).
+        int axis = aligned_axis(normal);
+        if (axis != -1)
+        {
+            double o = origin[axis], n = normal[axis];
+            float fo = float(o), fn = float(n);
+            if (soa && float_classify)
+            {
+                const float* c = float_columns.column(axis);
+                for (size_t v = begin ; v < end ; v++) distances[v] = (c[v] - fo) * fn;
+            }
+            else if (soa)
+            {
+                const double* c = columns.column(axis);
+                for (size_t v = begin ; v < end ; v++) distances[v] = (c[v] - o) * n;
+            }
+            else if (float_classify)
+            {
+                for (size_t v = begin ; v < end ; v++) distances[v] = (float(positions[v][axis]) - fo) * fn;
+            }
+            else
+            {
+                for (size_t v = begin ; v < end ; v++) distances[v] = (double(positions[v][axis]) - o) * n;
+            }
+            return;
+        }
+
+        if (soa && float_classify)
+        {
+            signed_distances(float_columns.x.data() + begin, float_columns.y.data() + begin, float_columns.z.data() + begin, end - begin, distances.data() + begin);
+        }
+        else if (soa)
+        {
+            signed_distances(columns.x.data() + begin, columns.y.data() + begin, columns.z.data() + begin, end - begin, distances.data() + begin);
+        }
+        else if (float_classify)
+        {
+            std::array<float, 3> o = {{ float(origin[0]), float(origin[1]), float(origin[2]) }};
+            std::array<float, 3> n = {{ float(normal[0]), float(normal[1]), float(normal[2]) }};
+            for (size_t v = begin ; v < end ; v++)
+            {
+                const Vector& p = positions[v];
+                distances[v] = (float(p[0]) - o[0]) * n[0]
+                             + (float(p[1]) - o[1]) * n[1]
+                             + (float(p[2]) - o[2]) * n[2];
+            }
+        }
+        else
+        {
+            for (size_t v = begin ; v < end ; v++)
+            {
+                const Vector& p = positions[v];
+                distances[v] = (double(p[0]) - origin[0]) * normal[0]
+                             + (double(p[1]) - origin[1]) * normal[1]
+                             + (double(p[2]) - origin[2]) * normal[2];
+            }
+        }
+    }
+
+    //
+    // Signed distance kernel over separate x, y and z arrays of n vertices, in double precision.
+    // The SIMD paths compute exactly the same values as the scalar loop.
+    //
+    void signed_distances(const double* x, const double* y, const double* z, size_t n, double* out) const
+    {
+        size_t v = 0;
+
+        #if defined(__AVX512F__)
+        __m512d ox = _mm512_set1_pd(origin[0]), oy = _mm512_set1_pd(origin[1]), oz = _mm512_set1_pd(origin[2]);
+        __m512d nx = _mm512_set1_pd(normal[0]), ny = _mm512_set1_pd(normal[1]), nz = _mm512_set1_pd(normal[2]);
+        for ( ; v + 8 <= n ; v += 8)
+        {
+            __m512d d =         _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(x + v), ox), nx);
+            d = _mm512_add_pd(d, _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(y + v), oy), ny));
+            d = _mm512_add_pd(d, _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(z + v), oz), nz));
+            _mm512_storeu_pd(out + v, d);
+        }
+        #elif defined(__AVX2__)
+        __m256d ox = _mm256_set1_pd(origin[0]), oy = _mm256_set1_pd(origin[1]), oz = _mm256_set1_pd(origin[2]);
+        __m256d nx = _mm256_set1_pd(normal[0]), ny = _mm256_set1_pd(normal[1]), nz = _mm256_set1_pd(normal[2]);
+        for ( ; v + 4 <= n ; v += 4)
+        {
+            __m256d d =         _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x + v), ox), nx);
+            d = _mm256_add_pd(d, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(y + v), oy), ny));
+            d = _mm256_add_pd(d, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(z + v), oz), nz));
+            _mm256_storeu_pd(out + v, d);
+        }
+        #elif SLICER_NEON
+        float64x2_t ox = vdupq_n_f64(origin[0]), oy = vdupq_n_f64(origin[1]), oz = vdupq_n_f64(origin[2]);
+        float64x2_t nx = vdupq_n_f64(normal[0]), ny = vdupq_n_f64(normal[1]), nz = vdupq_n_f64(normal[2]);
+        for ( ; v + 2 <= n ; v += 2)
+        {
+            float64x2_t d =    vmulq_f64(vsubq_f64(vld1q_f64(x + v), ox), nx);
+            d = vaddq_f64(d, vmulq_f64(vsubq_f64(vld1q_f64(y + v), oy), ny));
+            d = vaddq_f64(d, vmulq_f64(vsubq_f64(vld1q_f64(z + v), oz), nz));
+            vst1q_f64(out + v, d);
+        }
+        #endif
+
+        for ( ; v < n ; v++)
+        {
+            out[v] = (x[v] - origin[0]) * normal[0]
+                   + (y[v] - origin[1]) * normal[1]
+                   + (z[v] - origin[2]) * normal[2];
+        }
+    }
+
+    //
+    // Same as above in single precision, with results widened to double.
+    //
+    void signed_distances(const float* x, const float* y, const float* z, size_t n, double* out) const
+    {
+        float o[3] = { float(origin[0]), float(origin[1]), float(origin[2]) };
+        float d[3] = { float(normal[0]), float(normal[1]), float(normal[2]) };
+        size_t v = 0;
+
+        #if defined(__AVX512F__)
+        __m512 ox = _mm512_set1_ps(o[0]), oy = _mm512_set1_ps(o[1]), oz = _mm512_set1_ps(o[2]);
+        __m512 nx = _mm512_set1_ps(d[0]), ny = _mm512_set1_ps(d[1]), nz = _mm512_set1_ps(d[2]);
+        for ( ; v + 16 <= n ; v += 16)
+        {
+            __m512 r =         _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(x + v), ox), nx);
+            r = _mm512_add_ps(r, _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(y + v), oy), ny));
+            r = _mm512_add_ps(r, _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(z + v), oz), nz));
+            // The maskz forms avoid a spurious -Wmaybe-uninitialized in some GCC headers.
+            __m512d halves = _mm512_castps_pd(r);
+            _mm512_storeu_pd(out + v,     _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 0))));
+            _mm512_storeu_pd(out + v + 8, _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 1))));
+        }
+        #elif defined(__AVX2__)
+        __m256 ox = _mm256_set1_ps(o[0]), oy = _mm256_set1_ps(o[1]), oz = _mm256_set1_ps(o[2]);
+        __m256 nx = _mm256_set1_ps(d[0]), ny = _mm256_set1_ps(d[1]), nz = _mm256_set1_ps(d[2]);
+        for ( ; v + 8 <= n ; v += 8)
+        {
+            __m256 r =         _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + v), ox), nx);
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(y + v), oy), ny));
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(z + v), oz), nz));
+            _mm256_storeu_pd(out + v,     _mm256_cvtps_pd(_mm256_castps256_ps128(r)));
+            _mm256_storeu_pd(out + v + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(r, 1)));
+        }
+        #elif SLICER_NEON
+        float32x4_t ox = vdupq_n_f32(o[0]), oy = vdupq_n_f32(o[1]), oz = vdupq_n_f32(o[2]);
+        float32x4_t nx = vdupq_n_f32(d[0]), ny = vdupq_n_f32(d[1]), nz = vdupq_n_f32(d[2]);
+        for ( ; v + 4 <= n ; v += 4)
+        {
+            float32x4_t r =    vmulq_f32(vsubq_f32(vld1q_f32(x + v), ox), nx);
+            r = vaddq_f32(r, vmulq_f32(vsubq_f32(vld1q_f32(y + v), oy), ny));
+            r = vaddq_f32(r, vmulq_f32(vsubq_f32(vld1q_f32(z + v), oz), nz));
+            vst1q_f64(out + v,     vcvt_f64_f32(vget_low_f32(r)));
+            vst1q_f64(out + v + 2, vcvt_high_f64_f32(r));
+        }
+        #endif
+
+        for ( ; v < n ; v++)
+        {
+            out[v] = (x[v] - o[0]) * d[0]
+                   + (y[v] - o[1]) * d[1]
+                   + (z[v] - o[2]) * d[2];
+        }
+    }
+
+    //
+    // Tell if triangle t has vertices strictly on both sides of the plane.
+    // Triangles for which this is false are never split by do_triangle.
+    //
+    bool crosses(const Triangle& t) const
+    {
+        double a = distances[t[0]], b = distances[t[1]], c = distances[t[2]];
+        return std::min(a, std::min(b, c)) < 0 && std::max(a, std::max(b, c)) > 0;
+    }
+
+    //
+    // Compute lambda such that lambda*P + (1-lambda)*Q
+    // is the intersection between the plane and line PQ,
+    // where P and Q are vertices i and j.
+    //      lambda is in [0, 1]   =>  [PQ] intersects plane
+    //      lambda is infinite    =>  [PQ] parallel to plane
+    //      lambda is NaN         =>  [PQ] contained in plane
+    //
+    double get_lambda(Index i, Index j) const
+    {
+        return distances[j] / (distances[j] - distances[i]);
+    }
+
+    //
+    // If edge [ij] intersects plane, add intersection vertex to mesh and return its index.
+    // If the intersection vertex has already been computed before, only return its index.
+    // If intersection does not exist, return none.
+    //
+    Index get_intersection(Index i, Index j)
+    {
+        // We require i<j.
+        if (i > j) std::swap(i, j);
+
+        // Compute lambda and return none if no intersection.
+        double lambda = get_lambda(i, j);
+        if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+        // If the intersection has already been computed, return its index.
+        Index found = intersections.find(i, j);
+        if (stats) (found != none ? hits : misses)++;
+        if (found != none) return found;
+
+        // Otherwise, compute the intersection, append it to the mesh, and return its index.
+        // The new vertex lies on the plane, so its distance is zero.
+        const Vector& p = positions[i];
+        const Vector& q = positions[j];
+        Index m = positions.size();
+        distances.push_back(0);
+        positions.push_back(
+        {
+            Scalar(lambda*p[0] + (1-lambda)*q[0]),
+            Scalar(lambda*p[1] + (1-lambda)*q[1]),
+            Scalar(lambda*p[2] + (1-lambda)*q[2])
+        });
+        intersections.insert(i, j, m);
+        return m;
+    }
+
+
+
+    //
+    // If triangle tid intersects plane, split it and returns true.
+    // Otherwise do nothing and return false.
+    //
+    bool do_triangle(size_t tid)
+    {
+        if (edge_cut) return do_triangle(tid, edge_table);
+        for (int n=0 ; n<3 ; n++)
+        {
+            Index i = triangles[tid][n];
+            Index j = triangles[tid][(n+1) % 3];
+            Index k = triangles[tid][(n+2) % 3];
+
+            // If edge [jk] intersects plane.
+            Index m = get_intersection(j, k);
+            if (m != none)
+            {
+                triangles.push_back({ i, j, m });
+                triangles[tid] = { i, m, k };
+                if (stats) count_split(tid);
+                return true;
+            }
+        }
+        if (stats) last_split = size_t(-1);
+        return false;
+    }
+
+
+
+    //
+    // Count a split of triangle tid by do_triangle, which is a retry if the previous call split it too.
+    // Calls that don't split reset last_split.
+    //
+    void count_split(size_t tid)
+    {
+        if (tid == last_split) retries++;
+        last_split = tid;
+    }
+
+
+
+    //
+    // Same as get_intersection and do_triangle, with intersection vertices stored in the edge table.
+    // Edge e is the edge [ij].
+    //
+    Index get_intersection(Index i, Index j, Index e, EdgeTable& table)
+    {
+        if (i > j) std::swap(i, j);
+
+        double lambda = get_lambda(i, j);
+        if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+        Index found = table.vertex(e);
+        if (stats) (found != none ? hits : misses)++;
+        if (found != none) return found;
+
+        const Vector& p = positions[i];
+        const Vector& q = positions[j];
+        Index m = positions.size();
+        distances.push_back(0);
+        positions.push_back(
+        {
+            Scalar(lambda*p[0] + (1-lambda)*q[0]),
+            Scalar(lambda*p[1] + (1-lambda)*q[1]),
+            Scalar(lambda*p[2] + (1-lambda)*q[2])
+        });
+        table.split(e, m);
+        return m;
+    }
+
+    bool do_triangle(size_t tid, EdgeTable& table)
+    {
+        for (int n=0 ; n<3 ; n++)
+        {
+            Index i = triangles[tid][n];
+            Index j = triangles[tid][(n+1) % 3];
+            Index k = triangles[tid][(n+2) % 3];
+            std::array<Index, 3> sides = table.sides[tid];
+            Index e = sides[(n+1) % 3];
+
+            // If edge [jk] intersects plane, split it into [jm] and [mk], and add edge [im].
+            Index m = get_intersection(j, k, e, table);
+            if (m != none)
+            {
+                Index c = table.add();
+                triangles.push_back({ i, j, m });
+                table.sides.push_back({{ sides[n], table.half(e, j > k), c }});
+                triangles[tid] = { i, m, k };
+                table.sides[tid] = {{ c, table.half(e, k > j), sides[(n+2) % 3] }};
+                if (stats) count_split(tid);
+                return true;
+            }
+        }
+        if (stats) last_split = size_t(-1);
+        return false;
+    }
+
+
+
+    //
+    // Same as get_intersection and do_triangle, for the k-th plane of cut_batch.
+    //
+    Index get_intersection(Index i, Index j, int k)
+    {
+        // We require i<j.
+        if (i > j) std::swap(i, j);
+
+        // Compute lambda and return none if no intersection.
+        double h = offsets[k];
+        double lambda = (distances[j] - h) / (distances[j] - distances[i]);
+        if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+        // If the intersection has already been computed, return its index.
+        Index found = slab_intersections[k].find(i, j);
+        if (stats) (found != none ? hits : misses)++;
+        if (found != none) return found;
+
+        // Otherwise, compute the intersection, append it to the mesh, and return its index.
+        const Vector& p = positions[i];
+        const Vector& q = positions[j];
+        Index m = positions.size();
+        distances.push_back(h);
+        positions.push_back(
+        {
+            Scalar(lambda*p[0] + (1-lambda)*q[0]),
+            Scalar(lambda*p[1] + (1-lambda)*q[1]),
+            Scalar(lambda*p[2] + (1-lambda)*q[2])
+        });
+        slab_intersections[k].insert(i, j, m);
+        return m;
+    }
+
+    bool do_triangle(size_t tid, int k)
+    {
+        for (int n=0 ; n<3 ; n++)
+        {
+            Index i = triangles[tid][n];
+            Index j = triangles[tid][(n+1) % 3];
+            Index l = triangles[tid][(n+2) % 3];
+
+            // If edge [jl] intersects plane k.
+            Index m = get_intersection(j, l, k);
+            if (m != none)
+            {
+                triangles.push_back({ i, j, m });
+                triangles[tid] = { i, m, l };
+                if (stats) count_split(tid);
+                return true;
+            }
+        }
+        if (stats) last_split = size_t(-1);
+        return false;
+    }
+
+
+
+    //
+    // Signed distance of point p to plane (o, n), in units of the normal length.
+    //
+    static double distance(const Vector& p, const Vector& o, const Vector& n)
+    {
+        return (p[0] - o[0]) * n[0]
+             + (p[1] - o[1]) * n[1]
+             + (p[2] - o[2]) * n[2];
+    }
+
+    //
+    // Return the axis (0, 1 or 2) along which normal n points, or -1 if it is not axis-aligned.
+    //
+    static int aligned_axis(const Vector& n)
+    {
+        if (n[1] == 0 && n[2] == 0 && n[0] != 0) return 0;
+        if (n[0] == 0 && n[2] == 0 && n[1] != 0) return 1;
+        if (n[0] == 0 && n[1] == 0 && n[2] != 0) return 2;
+        return -1;
+    }
+
+    //
+    // Tell if two normals are parallel (up to rounding errors).
+    //
+    static bool parallel(const Vector& a, const Vector& b)
+    {
+        Vector c = {{ a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] }};
+        double aa = a[0]*a[0] + a[1]*a[1] + a[2]*a[2];
+        double bb = b[0]*b[0] + b[1]*b[1] + b[2]*b[2];
+        return c[0]*c[0] + c[1]*c[1] + c[2]*c[2] <= 1e-20 * aa * bb;
+    }
+
+    //
+    // Planes parallel to each other, sorted by their offsets along the normal of the first one.
+    //
+    struct ContourGroup
+    {
+        Vector              origin;
+        Vector              normal;
+        std::vector<double> offsets;
+        std::vector<size_t> planes;     // Index of the plane of each offset, in the contours result.
+
+        // Number of planes strictly below point p.
+        int slab(const Vector& p) const
+        {
+            return int(std::upper_bound(offsets.begin(), offsets.end(), distance(p, origin, normal)) - offsets.begin());
+        }
+    };
+
+    //
+    // Split the planes of contours into groups of parallel planes, and set result to one empty contour per plane.
+    //
+    void contour_groups(std::vector<ContourGroup>& groups, std::vector<Contour>& result) const
+    {
+        std::vector<Plane> list = planes;
+        if (list.empty()) list.push_back({ origin, normal });
+        result.assign(list.size(), Contour());
+
+        std::vector<bool> done(list.size(), false);
+        for (size_t first = 0 ; first < list.size() ; first++)
+        {
+            if (done[first]) continue;
+
+            // Gather the planes parallel to this one, sorted by offset.
+            ContourGroup group;
+            group.origin = list[first].origin;
+            group.normal = list[first].normal;
+            std::vector<std::pair<double, size_t>> sorted;
+            for (size_t p = first ; p < list.size() ; p++)
+            {
+                if (done[p] || !parallel(list[p].normal, group.normal)) continue;
+                sorted.push_back(std::make_pair(distance(list[p].origin, group.origin, group.normal), p));
+                done[p] = true;
+            }
+            std::sort(sorted.begin(), sorted.end());
+            for (const auto& entry : sorted)
+            {
+                group.offsets.push_back(entry.first);
+                group.planes.push_back(entry.second);
+            }
+            groups.push_back(group);
+        }
+    }
+
+    //
+    // Compute the contours of the mesh (positions, triangles) with the planes of group, into result.
+    //
+    static void group_contours(const ContourGroup& group, const std::vector<Vector>& positions, const std::vector<Triangle>& triangles,
+                               std::vector<Contour>& result)
+    {
+        const std::vector<double>& h = group.offsets;
+        std::vector<ContourBuilder> builders(h.size());
+
+        // Add the segments of each triangle to the contours of the planes it crosses.
+        for (const Triangle& t : triangles)
+        {
+            double d[3];
+            int lo = h.size(), hi = 0;
+            for (int v = 0 ; v < 3 ; v++)
+            {
+                d[v] = distance(positions[t[v]], group.origin, group.normal);
+                int slab = std::upper_bound(h.begin(), h.end(), d[v]) - h.begin();
+                lo = std::min(lo, slab);
+                hi = std::max(hi, slab);
+            }
+            for (int k = lo ; k < hi ; k++)
+            {
+                double r[3] = { d[0] - h[k], d[1] - h[k], d[2] - h[k] };
+                builders[k].add(t, r, positions);
+            }
+        }
+
+        for (size_t k = 0 ; k < h.size() ; k++)
+        {
+            builders[k].finish();
+            std::swap(result[group.planes[k]], builders[k].contour);
+        }
+    }
+
+    //
+    // Contour being built by contours.
+    //
+    struct ContourBuilder
+    {
+        Contour             contour;
+        EdgeMap             edges;      // Point index of each crossing edge.
+        std::vector<Index>  next;       // Next point along the contour, or none.
+        std::vector<bool>   has_prev;   // If some point is followed by this one.
+
+        // Return the index of the intersection point of edge [ij], given the distances of i and j to the plane.
+        Index point(Index i, Index j, const std::vector<Vector>& positions, double di, double dj)
+        {
+            if (i > j) { std::swap(i, j); std::swap(di, dj); }
+            Index m = edges.find(i, j);
+            if (m != none) return m;
+
+            const Vector& p = positions[i];
+            const Vector& q = positions[j];
+            double lambda = dj / (dj - di);
+            m = contour.points.size();
+            contour.points.push_back(
+            {
+                Scalar(lambda*p[0] + (1-lambda)*q[0]),
+                Scalar(lambda*p[1] + (1-lambda)*q[1]),
+                Scalar(lambda*p[2] + (1-lambda)*q[2])
+            });
+            next.push_back(none);
+            has_prev.push_back(false);
+            edges.insert(i, j, m);
+            return m;
+        }
+
+        // Add the segment of triangle t, given the distances of its vertices to the plane.
+        void add(const Triangle& t, const double d[3], const std::vector<Vector>& positions)
+        {
+            Index from = none, to = none;
+            for (int n=0 ; n<3 ; n++)
+            {
+                int a = n, b = (n+1) % 3;
+                bool above = d[a] >= 0;
+                if (above == (d[b] >= 0)) continue;
+                Index m = point(t[a], t[b], positions, d[a], d[b]);
+                if (above) to = m;
+                else       from = m;
+            }
+            if (from == none || to == none) return;
+            next[from]   = to;
+            has_prev[to] = true;
+        }
+
+        // Chain segments into loops (and open polylines, for meshes with boundaries).
+        void finish()
+        {
+            std::vector<bool> visited(next.size(), false);
+            auto walk = [&](Index start)
+            {
+                std::vector<Index> loop;
+                Index v = start;
+                for ( ; v != none && !visited[v] ; v = next[v])
+                {
+                    visited[v] = true;
+                    loop.push_back(v);
+                }
+                if (v == start) loop.push_back(start);
+                contour.loops.push_back(loop);
+            };
+            for (size_t v = 0 ; v < next.size() ; v++) if (!has_prev[v]) walk(v);
+            for (size_t v = 0 ; v < next.size() ; v++) if (!visited[v])  walk(v);
+        }
+    };
+
+
+
+    //
+    // Per-thread state of cut_parallel.
+    //
+    struct Worker
+    {
+        Index                               first = 0;      // First temporary vertex index.
+        std::vector<size_t>                 split;          // Triangles modified by this thread.
+        std::vector<Triangle>               children;       // Triangles appended by this thread.
+        std::vector<std::pair<Index, Index>> edges;         // Edges of new intersection vertices, in order.
+        std::vector<Vector>                 points;         // Positions of new intersection vertices.
+        std::vector<Index>                  remap;          // Final indices of new intersection vertices.
+        EdgeMap                             local;          // Same as intersections, for new intersection vertices.
+        size_t                              hits = 0, misses = 0, retries = 0;  // Counters of the cut (see Stats).
+        size_t                              last_split = size_t(-1);
+
+        void clear(Index first_index)
+        {
+            first = first_index;
+            split.clear();
+            children.clear();
+            edges.clear();
+            points.clear();
+            remap.clear();
+            local.clear();
+        }
+
+        void finalize(Triangle& t) const
+        {
+            for (Index& i : t) if (i >= first) i = remap[i - first];
+        }
+    };
+
+    //
+    // Same as get_intersection, but new intersection vertices are stored in worker
+    // with temporary indices, and intersections is only read.
+    //
+    Index get_intersection(Index i, Index j, Worker& worker) const
+    {
+        // We require i<j.
+        if (i > j) std::swap(i, j);
+
+        // Compute lambda and return none if no intersection.
+        // Temporary vertices lie on the plane.
+        double di = i < worker.first ? distances[i] : 0;
+        double dj = j < worker.first ? distances[j] : 0;
+        double lambda = dj / (dj - di);
+        if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+        // If the intersection has already been computed, return its index.
+        Index found = intersections.find(i, j);
+        if (stats && found != none) worker.hits++;
+        if (found != none) return found;
+        found = worker.local.find(i, j);
+        if (stats) (found != none ? worker.hits : worker.misses)++;
+        if (found != none) return worker.first + found;
+
+        // Otherwise, compute the intersection and give it the next temporary index.
+        const Vector& p = positions[i];
+        const Vector& q = positions[j];
+        Index m = worker.edges.size();
+        worker.edges.push_back(std::make_pair(i, j));
+        worker.points.push_back(
+        {
+            Scalar(lambda*p[0] + (1-lambda)*q[0]),
+            Scalar(lambda*p[1] + (1-lambda)*q[1]),
+            Scalar(lambda*p[2] + (1-lambda)*q[2])
+        });
+        worker.local.insert(i, j, m);
+        return worker.first + m;
+    }
+
+    //
+    // Same as do_triangle, but appended triangles are stored in worker.
+    //
+    bool do_triangle(size_t tid, Worker& worker)
+    {
+        for (int n=0 ; n<3 ; n++)
+        {
+            Index i = triangles[tid][n];
+            Index j = triangles[tid][(n+1) % 3];
+            Index k = triangles[tid][(n+2) % 3];
+
+            // If edge [jk] intersects plane.
+            Index m = get_intersection(j, k, worker);
+            if (m != none)
+            {
+                worker.children.push_back({ i, j, m });
+                triangles[tid] = { i, m, k };
+                if (stats)
+                {
+                    worker.retries += tid == worker.last_split;
+                    worker.last_split = tid;
+                }
+                return true;
+            }
+        }
+        if (stats) worker.last_split = size_t(-1);
+        return false;
+    }
+
+
+
+public:
+
+    //
+    // Compact result of a cut which leaves the mesh unchanged.
+    // The cut mesh is the mesh with triangles[replaced[k]] changed from original[k] to changed[k],
+    // followed by the new vertices and the appended triangles, which are numbered after the vertices
+    // and triangles of the mesh. replaced is in increasing order.
+    // A delta can be applied to the mesh and reverted (see apply and revert), or saved on its own (see save_delta).
+    //
+    struct Delta
+    {
+        size_t                  base_vertices  = 0;     // Size of the mesh that was cut.
+        size_t                  base_triangles = 0;
+        std::vector<Vector>     vertices;
+        std::vector<Index>      replaced;
+        std::vector<Triangle>   original;
+        std::vector<Triangle>   changed;
+        std::vector<Triangle>   appended;
+
+        // Scratch buffers of cut, which keep their capacity from one cut to the next.
+        EdgeMap                 intersections;
+        std::vector<Index>      candidates;
+    };
+
+    //
+    // Build the triangle index used by the next delta cuts, so that they only visit the triangles near the plane.
+    // The index is ignored once the mesh has changed.
+    //
+    void build_index()
+    {
+        index.build(positions, triangles);
+    }
+
+    //
+    // Cut the mesh by plane into delta, without modifying this Slicer.
+    //
+    // This gives the same mesh as cut. Since the Slicer is only read, several threads can cut it
+    // at the same time, each into its own delta. Signed distances are computed on the fly for the
+    // vertices of the candidate triangles, which are all triangles, or only the ones near the plane
+    // if the triangle index is up to date (see build_index).
+    // The candidates are processed as in cut_indexed.
+    //
+    void cut(const Plane& plane, Delta& delta) const
+    {
+        std::vector<Index>& candidates = delta.candidates;
+        if (index.size() == triangles.size() && index.built() == triangles.size())
+        {
+            index.query(plane.origin, plane.normal, candidates);
+            std::sort(candidates.begin(), candidates.end());
+        }
+        else
+        {
+            candidates.resize(triangles.size());
+            for (size_t tid = 0 ; tid < triangles.size() ; tid++) candidates[tid] = Index(tid);
+        }
+        cut_candidates(plane, delta);
+    }
+
+    //
+    // State kept by recut from one plane of a sweep to the next.
+    //
+    struct Sweep
+    {
+        Delta                   delta;                      // Cut by the last plane.
+        bool                    built  = false;             // Whether the arrays below are built for normal.
+        Vector                  normal = {{ 0, 0, 0 }};
+        double                  offset = 0;                 // Offset of the last plane along normal.
+        double                  extent = 0;                 // Largest sum of |p[a]*normal[a]| over vertices and planes,
+                                                            // which bounds the rounding errors of offsets.
+        std::vector<double>     keys;                       // Offsets of the vertices along normal, in increasing order,
+        std::vector<Index>      order;                      // and the vertices in this order.
+        std::vector<size_t>     first;                      // Triangles of vertex v are incident[first[v]] to incident[first[v+1]-1].
+        std::vector<Index>      incident;
+    };
+
+    //
+    // Cut the mesh by plane into sweep.delta, like cut(plane, delta), reusing the cut by the previous plane of the sweep.
+    //
+    // When the plane was only moved along its normal, a triangle can only cross the new plane if it crossed
+    // the previous one or if one of its vertices lies between the two planes. These vertices are found by
+    // binary search in the vertices sorted along the normal, so each step only visits the triangles
+    // around the vertices swept past and the triangles of the cut. Intersection points move with the plane,
+    // so they are all computed again.
+    //
+    // The first plane, and any plane with a different normal or after the mesh changed, are cut from scratch,
+    // and the vertices are sorted along the new normal in O(n log n).
+    //
+    void recut(const Plane& plane, Sweep& sweep) const
+    {
+        const Vector& n = plane.normal;
+        const Vector& o = plane.origin;
+        double offset = double(o[0]) * n[0] + double(o[1]) * n[1] + double(o[2]) * n[2];
+        double extent = std::fabs(double(o[0]) * n[0]) + std::fabs(double(o[1]) * n[1]) + std::fabs(double(o[2]) * n[2]);
+        Delta& delta = sweep.delta;
+        std::vector<Index>& candidates = delta.candidates;
+
+        bool valid = sweep.built && sweep.normal == n
+                  && delta.base_vertices == positions.size() && delta.base_triangles == triangles.size();
+        if (!valid)
+        {
+            build_sweep(n, sweep);
+            cut(plane, delta);
+            sweep.offset = offset;
+            sweep.extent = std::max(sweep.extent, extent);
+            return;
+        }
+
+        // A vertex whose distance changed sign is between the planes, up to rounding errors.
+        sweep.extent = std::max(sweep.extent, extent);
+        double margin = 1e-12 * sweep.extent;
+        double lo = std::min(offset, sweep.offset) - margin;
+        double hi = std::max(offset, sweep.offset) + margin;
+        size_t begin = std::lower_bound(sweep.keys.begin(), sweep.keys.end(), lo) - sweep.keys.begin();
+        size_t end   = std::upper_bound(sweep.keys.begin(), sweep.keys.end(), hi) - sweep.keys.begin();
+
+        // The triangles which crossed the previous plane are still in candidates.
+        for (size_t k = begin ; k < end ; k++)
+        {
+            Index v = sweep.order[k];
+            candidates.insert(candidates.end(), sweep.incident.begin() + sweep.first[v], sweep.incident.begin() + sweep.first[v+1]);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        cut_candidates(plane, delta);
+        sweep.offset = offset;
+    }
+
+    //
+    // Save the mesh cut by delta to an OBJ file, like save after a cut.
+    //
+    bool save(const std::string& filename, const Delta& delta) const
+    {
+        Writer file;
+        if (!file.open(filename)) return false;
+
+        // Without reorder, write the arrays in order.
+        if (original_vertices.empty() && original_triangles.empty())
+        {
+            for (const Vector& p : positions)      file.put_vertex(p);
+            for (const Vector& p : delta.vertices) file.put_vertex(p);
+
+            size_t r = 0;
+            for (size_t tid = 0 ; tid < triangles.size() ; tid++)
+            {
+                bool replaced = r < delta.replaced.size() && size_t(delta.replaced[r]) == tid;
+                file.put_triangle(replaced ? delta.changed[r++] : triangles[tid]);
+            }
+            for (const Triangle& t : delta.appended) file.put_triangle(t);
+            return file.close();
+        }
+
+        // After reorder, write the mesh in its original order, as save does.
+        std::vector<Vector> restored_positions;
+        std::vector<Triangle> restored_triangles;
+        restore(restored_positions, restored_triangles);
+        auto original = [&](Triangle t)
+        {
+            for (Index& v : t) if (size_t(v) < original_vertices.size()) v = original_vertices[v];
+            return t;
+        };
+        for (size_t r = 0 ; r < delta.replaced.size() ; r++)
+        {
+            size_t tid = delta.replaced[r];
+            restored_triangles[tid < original_triangles.size() ? size_t(original_triangles[tid]) : tid] = original(delta.changed[r]);
+        }
+        for (const Vector& p : restored_positions) file.put_vertex(p);
+        for (const Vector& p : delta.vertices)     file.put_vertex(p);
+        for (const Triangle& t : restored_triangles) file.put_triangle(t);
+        for (const Triangle& t : delta.appended)     file.put_triangle(original(t));
+        return file.close();
+    }
+
+    //
+    // Apply delta to the mesh, which then becomes the cut mesh.
+    // Returns false and leaves the mesh unchanged if the delta was computed on a mesh of another size.
+    //
+    bool apply(const Delta& delta)
+    {
+        if (positions.size() != delta.base_vertices || triangles.size() != delta.base_triangles) return false;
+        positions.insert(positions.end(), delta.vertices.begin(), delta.vertices.end());
+        for (size_t r = 0 ; r < delta.replaced.size() ; r++) triangles[delta.replaced[r]] = delta.changed[r];
+        triangles.insert(triangles.end(), delta.appended.begin(), delta.appended.end());
+
+        // The replaced triangles have other edges.
+        edge_table.clear();
+        return true;
+    }
+
+    //
+    // Undo apply(delta), which must be the last change of the mesh.
+    // Returns false and leaves the mesh unchanged if the mesh doesn't have the size of the cut mesh.
+    // The triangle index survives an apply followed by a revert.
+    //
+    bool revert(const Delta& delta)
+    {
+        if (positions.size() != delta.base_vertices  + delta.vertices.size()
+         || triangles.size() != delta.base_triangles + delta.appended.size()) return false;
+        positions.resize(delta.base_vertices);
+        triangles.resize(delta.base_triangles);
+        for (size_t r = 0 ; r < delta.replaced.size() ; r++) triangles[delta.replaced[r]] = delta.original[r];
+
+        // Vertices past the end of positions may be replaced by different ones.
+        columns.truncate(positions.size());
+        float_columns.truncate(positions.size());
+        edge_table.clear();
+        return true;
+    }
+
+    //
+    // Save delta to a binary file (.mmsd), which is a DeltaHeader followed by the raw arrays of the delta
+    // (vertices, replaced, original, changed and appended, in native byte order).
+    // After reorder, the delta is saved for the mesh in its original order (the one save writes),
+    // so that it can be applied to the mesh loaded from the same file.
+    //
+    bool save_delta(const std::string& filename, const Delta& delta) const
+    {
+        if (original_vertices.empty() && original_triangles.empty()) return write_delta(filename, delta);
+        Delta restored;
+        restore(delta, restored);
+        return write_delta(filename, restored);
+    }
+
+    //
+    // Change delta, computed on the reordered mesh, into restored, the same delta for the mesh in its original order.
+    // The indices of vertices and triangles are mapped as in restore, and replaced is sorted again.
+    //
+    void restore(const Delta& delta, Delta& restored) const
+    {
+        auto vertex = [&](Index v) { return size_t(v) < original_vertices.size() ? original_vertices[v] : v; };
+        auto triangle = [&](Triangle t)
+        {
+            for (Index& v : t) v = vertex(v);
+            return t;
+        };
+
+        restored.base_vertices  = delta.base_vertices;
+        restored.base_triangles = delta.base_triangles;
+        restored.vertices       = delta.vertices;
+        restored.appended.clear();
+        for (const Triangle& t : delta.appended) restored.appended.push_back(triangle(t));
+
+        std::vector<std::pair<Index, size_t>> order;
+        for (size_t r = 0 ; r < delta.replaced.size() ; r++)
+        {
+            Index tid = delta.replaced[r];
+            order.push_back(std::make_pair(size_t(tid) < original_triangles.size() ? original_triangles[tid] : tid, r));
+        }
+        std::sort(order.begin(), order.end());
+        restored.replaced.clear();
+        restored.original.clear();
+        restored.changed.clear();
+        for (const std::pair<Index, size_t>& entry : order)
+        {
+            restored.replaced.push_back(entry.first);
+            restored.original.push_back(triangle(delta.original[entry.second]));
+            restored.changed.push_back(triangle(delta.changed[entry.second]));
+        }
+    }
+
+    //
+    // Write delta as it is, for save_delta.
+    //
+    static bool write_delta(const std::string& filename, const Delta& delta)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file) return false;
+
+        DeltaHeader header;
+        header.base_vertices  = delta.base_vertices;
+        header.base_triangles = delta.base_triangles;
+        header.vertex_count   = delta.vertices.size();
+        header.replaced_count = delta.replaced.size();
+        header.appended_count = delta.appended.size();
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+               && write_array(file, delta.vertices)
+               && write_array(file, delta.replaced)
+               && write_array(file, delta.original)
+               && write_array(file, delta.changed)
+               && write_array(file, delta.appended);
+
+        return std::fclose(file) == 0 && ok;
+    }
+
+    //
+    // Load delta from a file written by save_delta.
+    // A file whose sizes don't match its header, with replaced triangles out of range or out of order,
+    // or with a vertex index out of range of the cut mesh, is rejected and delta is left empty.
+    //
+    static bool load_delta(const std::string& filename, Delta& delta)
+    {
+        delta = Delta();
+        MappedFile file;
+        if (!file.open(filename)) return false;
+        DeltaHeader header;
+        if (file.size < sizeof(header)) return false;
+        std::memcpy(&header, file.data, sizeof(header));
+        if (!header.valid()) return false;
+
+        // Check the counts against the file size before multiplying, so that a corrupt header can't overflow.
+        const size_t replaced_size = sizeof(Index) + 2*sizeof(Triangle);
+        size_t available = file.size - sizeof(header);
+        if (header.vertex_count > available / sizeof(Vector)) return false;
+        available -= size_t(header.vertex_count) * sizeof(Vector);
+        if (header.replaced_count > available / replaced_size) return false;
+        available -= size_t(header.replaced_count) * replaced_size;
+        if (header.appended_count > available / sizeof(Triangle)) return false;
+        if (available != size_t(header.appended_count) * sizeof(Triangle)) return false;
+        if (header.base_vertices > std::numeric_limits<size_t>::max() - header.vertex_count) return false;
+
+        const char* s = file.data + sizeof(header);
+        delta.base_vertices  = header.base_vertices;
+        delta.base_triangles = header.base_triangles;
+        s = read_array(s, header.vertex_count,   delta.vertices);
+        s = read_array(s, header.replaced_count, delta.replaced);
+        s = read_array(s, header.replaced_count, delta.original);
+        s = read_array(s, header.replaced_count, delta.changed);
+        s = read_array(s, header.appended_count, delta.appended);
+
+        // Replaced triangles are increasing triangles of the mesh, and every triangle refers to vertices of the cut mesh.
+        const size_t vertices = delta.base_vertices + delta.vertices.size();
+        bool valid = true;
+        for (size_t r = 0 ; r < delta.replaced.size() ; r++)
+        {
+            valid = valid && size_t(delta.replaced[r]) < delta.base_triangles && (r == 0 || delta.replaced[r-1] < delta.replaced[r]);
+        }
+        for (const std::vector<Triangle>* triangles : { &delta.original, &delta.changed, &delta.appended })
+        {
+            for (const Triangle& t : *triangles) for (Index v : t) valid = valid && size_t(v) < vertices;
+        }
+        if (!valid) delta = Delta();
+        return valid;
+    }
+
+    //
+    // Tell if a file name has the binary delta extension (.mmsd).
+    //
+    static bool is_delta(const std::string& filename)
+    {
+        static const std::string extension = ".mmsd";
+        return filename.size() >= extension.size()
+            && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+
+
+private:
+
+    //
+    // Header of binary delta files.
+    //
+    struct DeltaHeader
+    {
+        char        magic[4]        = { 'M', 'M', 'S', 'D' };
+        uint32_t    version         = 1;
+        uint32_t    scalar_size     = sizeof(Scalar);
+        uint32_t    index_size      = sizeof(Index);
+        uint64_t    base_vertices   = 0;
+        uint64_t    base_triangles  = 0;
+        uint64_t    vertex_count    = 0;
+        uint64_t    replaced_count  = 0;
+        uint64_t    appended_count  = 0;
+
+        bool valid() const
+        {
+            DeltaHeader expected;
+            return std::memcmp(magic, expected.magic, sizeof(magic)) == 0
+                && version     == expected.version
+                && scalar_size == expected.scalar_size
+                && index_size  == expected.index_size;
+        }
+    };
+
+    template<typename T>
+    static bool write_array(std::FILE* file, const std::vector<T>& array)
+    {
+        return std::fwrite(array.data(), sizeof(T), array.size(), file) == array.size();
+    }
+
+    template<typename T>
+    static const char* read_array(const char* s, size_t count, std::vector<T>& array)
+    {
+        array.resize(count);
+        if (count) std::memcpy(array.data(), s, count * sizeof(T));
+        return s + count * sizeof(T);
+    }
+
+    //
+    // Cut the mesh by plane into delta, splitting the triangles in delta.candidates (in increasing order)
+    // and the triangles they append. Afterwards, candidates only holds the triangles which crossed the plane.
+    //
+    void cut_candidates(const Plane& plane, Delta& delta) const
+    {
+        DeltaCut cut = { *this, plane, delta };
+        std::vector<Index>& candidates = delta.candidates;
+        delta.base_vertices  = positions.size();
+        delta.base_triangles = triangles.size();
+        delta.vertices.clear();
+        delta.replaced.clear();
+        delta.original.clear();
+        delta.changed.clear();
+        delta.appended.clear();
+
+        // Keep the crossing candidates, and make room for their intersections.
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](Index tid)
+        {
+            return !cut.crosses(triangles[tid]);
+        }), candidates.end());
+        delta.intersections.clear(candidates.size());
+        delta.replaced.reserve(candidates.size());
+        delta.original.reserve(candidates.size());
+        delta.changed.reserve(candidates.size());
+
+        for (Index tid : candidates)
+        {
+            Triangle t = triangles[tid];
+            bool split = false;
+            while (cut.crosses(t) && cut.do_triangle(t)) split = true;
+            if (!split) continue;
+            delta.replaced.push_back(tid);
+            delta.original.push_back(triangles[tid]);
+            delta.changed.push_back(t);
+        }
+        for (size_t a = 0 ; a < delta.appended.size() ; a++)
+        {
+            while (cut.crosses(delta.appended[a]) && cut.do_triangle(a)) {}
+        }
+    }
+
+    //
+    // Sort the vertices along normal n, and list the triangles of each vertex, for recut.
+    //
+    void build_sweep(const Vector& n, Sweep& sweep) const
+    {
+        sweep.built  = true;
+        sweep.normal = n;
+        sweep.extent = 0;
+        std::vector<std::pair<double, Index>> sorted(positions.size());
+        for (size_t v = 0 ; v < positions.size() ; v++)
+        {
+            const Vector& p = positions[v];
+            sorted[v] = std::make_pair(double(p[0]) * n[0] + double(p[1]) * n[1] + double(p[2]) * n[2], Index(v));
+            sweep.extent = std::max(sweep.extent, std::fabs(double(p[0]) * n[0]) + std::fabs(double(p[1]) * n[1]) + std::fabs(double(p[2]) * n[2]));
+        }
+        std::sort(sorted.begin(), sorted.end());
+        sweep.keys.resize(sorted.size());
+        sweep.order.resize(sorted.size());
+        for (size_t k = 0 ; k < sorted.size() ; k++)
+        {
+            sweep.keys[k]  = sorted[k].first;
+            sweep.order[k] = sorted[k].second;
+        }
+
+        // Triangles by vertex, with a counting sort.
+        sweep.first.assign(positions.size() + 1, 0);
+        for (const Triangle& t : triangles) for (Index v : t) sweep.first[v+1]++;
+        for (size_t v = 0 ; v < positions.size() ; v++) sweep.first[v+1] += sweep.first[v];
+        sweep.incident.resize(3 * triangles.size());
+        std::vector<size_t> next(sweep.first.begin(), sweep.first.end() - 1);
+        for (size_t tid = 0 ; tid < triangles.size() ; tid++) for (Index v : triangles[tid]) sweep.incident[next[v]++] = Index(tid);
+    }
+
+    //
+    // get_intersection and do_triangle for a delta cut.
+    // Vertices and triangles of the mesh are read from the Slicer, and new ones are written to the delta.
+    //
+    struct DeltaCut
+    {
+        const BasicSlicer&  mesh;
+        const Plane&        plane;
+        Delta&              delta;
+
+        double distance(Index v) const
+        {
+            if (size_t(v) >= delta.base_vertices) return 0;
+            const Vector& p = mesh.positions[v];
+            return (double(p[0]) - plane.origin[0]) * plane.normal[0]
+                 + (double(p[1]) - plane.origin[1]) * plane.normal[1]
+                 + (double(p[2]) - plane.origin[2]) * plane.normal[2];
+        }
+
+        const Vector& position(Index v) const
+        {
+            return size_t(v) < delta.base_vertices ? mesh.positions[v] : delta.vertices[v - delta.base_vertices];
+        }
+
+        bool crosses(const Triangle& t) const
+        {
+            double a = distance(t[0]), b = distance(t[1]), c = distance(t[2]);
+            return std::min(a, std::min(b, c)) < 0 && std::max(a, std::max(b, c)) > 0;
+        }
+
+        Index get_intersection(Index i, Index j)
+        {
+            if (i > j) std::swap(i, j);
+
+            double di = distance(i), dj = distance(j);
+            double lambda = dj / (dj - di);
+            if (!std::isfinite(lambda) || lambda < precision || lambda > 1-precision) return none;
+
+            Index found = delta.intersections.find(i, j);
+            if (found != none) return found;
+
+            const Vector& p = position(i);
+            const Vector& q = position(j);
+            Index m = Index(delta.base_vertices + delta.vertices.size());
+            delta.vertices.push_back(
+            {
+                Scalar(lambda*p[0] + (1-lambda)*q[0]),
+                Scalar(lambda*p[1] + (1-lambda)*q[1]),
+                Scalar(lambda*p[2] + (1-lambda)*q[2])
+            });
+            delta.intersections.insert(i, j, m);
+            return m;
+        }
+
+        // Split triangle t, and append its other half to the delta.
+        bool do_triangle(Triangle& t)
+        {
+            for (int n=0 ; n<3 ; n++)
+            {
+                Index i = t[n];
+                Index j = t[(n+1) % 3];
+                Index k = t[(n+2) % 3];
+
+                Index m = get_intersection(j, k);
+                if (m != none)
+                {
+                    delta.appended.push_back({ i, j, m });
+                    t = { i, m, k };
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Same for appended triangle a, which may move when the other half is appended.
+        bool do_triangle(size_t a)
+        {
+            Triangle t = delta.appended[a];
+            if (!do_triangle(t)) return false;
+            delta.appended[a] = t;
+            return true;
+        }
+    };
+
+
+
+public:
+
+    //
+    // Read JSON file with plane coordinates.
+    //
+    bool read_json(const std::string& filename)
+    {
+        MappedFile file;
+        if (!file.open(filename)) return false;
+
+        // Read the cutting plane, and the list of planes for cut_batch. This is either:
+        //  - the single plane given by "origin" and "normal",
+        //  - a "planes" array of objects with "origin" and "normal" arrays,
+        //  - or a single plane with "spacing" and "count" numbers, for a stack of parallel planes.
+        // There must be as many origins as normals, and count must be a whole number of planes from 1 to 2^20.
+        JsonReader json(file.data, file.data + file.size);
+        if (!json.parse()) return false;
+        const std::vector<Vector>& origins = json.origins;
+        const std::vector<Vector>& normals = json.normals;
+        if (origins.empty() || origins.size() != normals.size()) return false;
+        if (json.has_count && !(json.count >= 1 && json.count <= (1 << 20) && json.count == std::floor(json.count))) return false;
+        if (json.has_spacing && !std::isfinite(json.spacing)) return false;
+        origin = origins[0];
+        normal = normals[0];
+
+        planes.clear();
+        if (origins.size() > 1)
+        {
+            planes.reserve(origins.size());
+            for (size_t p = 0 ; p < origins.size() ; p++) planes.push_back({ origins[p], normals[p] });
+        }
+        else if (json.has_spacing && json.has_count)
+        {
+            set_planes(origin, normal, json.spacing, int(json.count));
+        }
+        else
+        {
+            planes.push_back({ origin, normal });
+        }
+
+        return true;
+    }
+
+private:
+
+    //
+    // Single-pass JSON reader for read_json.
+    // The whole document is checked against the JSON grammar, and the "origin" and "normal" arrays
+    // of three numbers and the "spacing" and "count" numbers of the top-level object are collected,
+    // as well as "origin" and "normal" arrays of the objects in its "planes" array, in document order.
+    // Other objects are only checked, so that unknown keys (e.g. metadata) are ignored.
+    // Keys are compared in place, and nothing is allocated except the collected arrays.
+    //
+    struct JsonReader
+    {
+        const char*         s;
+        const char*         end;
+        std::vector<Vector> origins;
+        std::vector<Vector> normals;
+        double              spacing = 0, count = 0;
+        bool                has_spacing = false, has_count = false;
+        int                 depth = 0;
+        bool                in_planes = false;      // Reading the top-level "planes" array.
+
+        JsonReader(const char* begin, const char* end) : s(begin), end(end) {}
+
+        bool parse()
+        {
+            if (!value(nullptr, 0)) return false;
+            skip();
+            return s == end;
+        }
+
+        void skip()
+        {
+            while (s < end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')) s++;
+        }
+
+        bool is(const char* key, size_t length, const char* name) const
+        {
+            return key && length == std::strlen(name) && std::memcmp(key, name, length) == 0;
+        }
+
+        // Tell if the values of the object being read are collected: the top-level object, or an object of "planes".
+        bool collected() const
+        {
+            return depth == 1 || (in_planes && depth == 3);
+        }
+
+        // Read a value, which is the value of key (of the given length) in its object, or of no key (null).
+        bool value(const char* key, size_t length)
+        {
+            skip();
+            if (s == end) return false;
+            if (*s == '{') return object();
+            if (*s == '[' && depth == 1 && is(key, length, "planes"))
+            {
+                in_planes = true;
+                bool ok = array(key, length);
+                in_planes = false;
+                return ok;
+            }
+            if (*s == '[') return array(key, length);
+            if (*s == '"') { const char* first; size_t size; return string(first, size); }
+            if (*s == 't') return literal("true");
+            if (*s == 'f') return literal("false");
+            if (*s == 'n') return literal("null");
+
+            double x;
+            if (!number(x)) return false;
+            if (depth == 1 && is(key, length, "spacing")) { spacing = x; has_spacing = true; }
+            if (depth == 1 && is(key, length, "count"))   { count   = x; has_count   = true; }
+            return true;
+        }
+
+        bool object()
+        {
+            if (++depth > 256) return false;
+            s++;
+            skip();
+            if (s < end && *s == '}') { s++; depth--; return true; }
+            for (;;)
+            {
+                const char* key;
+                size_t length;
+                skip();
+                if (!string(key, length)) return false;
+                skip();
+                if (s == end || *s != ':') return false;
+                s++;
+                if (!value(key, length)) return false;
+                skip();
+                if (s < end && *s == ',') { s++; continue; }
+                if (s < end && *s == '}') { s++; depth--; return true; }
+                return false;
+            }
+        }
+
+        // Arrays of exactly three numbers are collected if their key is "origin" or "normal" in a collected object.
+        bool array(const char* key, size_t length)
+        {
+            const bool collect = collected();
+            if (++depth > 256) return false;
+            s++;
+            skip();
+            Vector v = {{ 0, 0, 0 }};
+            size_t numbers = 0, values = 0;
+            if (s < end && *s == ']') s++;
+            else for (;;)
+            {
+                skip();
+                if (s < end && (*s == '-' || unsigned(*s - '0') < 10))
+                {
+                    double x;
+                    if (!number(x)) return false;
+                    if (numbers < 3) v[numbers] = Scalar(x);
+                    numbers++;
+                }
+                else if (!value(nullptr, 0)) return false;
+                values++;
+                skip();
+                if (s < end && *s == ',') { s++; continue; }
+                if (s < end && *s == ']') { s++; break; }
+                return false;
+            }
+            if (collect && numbers == 3 && values == 3)
+            {
+                if (is(key, length, "origin")) origins.push_back(v);
+                if (is(key, length, "normal")) normals.push_back(v);
+            }
+            depth--;
+            return true;
+        }
+
+        // Set [first, first+length) to the characters of the string, escapes included.
+        bool string(const char*& first, size_t& length)
+        {
+            if (s == end || *s != '"') return false;
+            first = ++s;
+            for ( ; s < end && *s != '"' ; s++)
+            {
+                if (*s == '\\' && ++s == end) return false;
+                if (unsigned(*s) < 0x20) return false;
+            }
+            if (s == end) return false;
+            length = s - first;
+            s++;
+            return true;
+        }
+
+        bool literal(const char* word)
+        {
+            size_t length = std::strlen(word);
+            if (size_t(end - s) < length || std::memcmp(s, word, length) != 0) return false;
+            s += length;
+            return true;
+        }
+
+        // Read a number with the JSON syntax, converted with strtod from a local copy.
+        bool number(double& x)
+        {
+            const char* first = s;
+            auto digits = [&]()
+            {
+                const char* start = s;
+                while (s < end && unsigned(*s - '0') < 10) s++;
+                return s > start;
+            };
+            if (s < end && *s == '-') s++;
+            if (!digits()) return false;
+            if (s < end && *s == '.') { s++; if (!digits()) return false; }
+            if (s < end && (*s == 'e' || *s == 'E'))
+            {
+                s++;
+                if (s < end && (*s == '+' || *s == '-')) s++;
+                if (!digits()) return false;
+            }
+
+            char copy[64];
+            size_t length = s - first;
+            if (length < sizeof(copy))
+            {
+                std::memcpy(copy, first, length);
+                copy[length] = 0;
+                x = std::strtod(copy, nullptr);
+            }
+            else x = std::strtod(std::string(first, s).c_str(), nullptr);
+            return true;
+        }
+    };
+
+};
+
+template<typename Scalar, typename Index>
+constexpr Index BasicSlicer<Scalar, Index>::none;
+
+template<typename Scalar, typename Index>
+constexpr double BasicSlicer<Scalar, Index>::precision;
+
+// Slicer with double precision coordinates and int indices.
+using Slicer = BasicSlicer<>;
+
+#endif
@@ -0,0 +1,362 @@
+#include "slicer.h"
+#include <set>
+
+/*
+
+    SLICER CONSISTENCY CHECKS
+
+    Usage:
+
+        g++ -O2 -pthread test.cpp -o test
+        ./test [torus.obj]
+
+    Every way of cutting the mesh by the same plane must give the same mesh.
+    Prints each failed check and returns a failure status if there is any.
+
+*/
+
+
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& name)
+{
+    if (!ok) { std::cout << "FAILED: " << name << std::endl; failures++; }
+}
+
+//
+// Triangles of a mesh as sorted lists of vertex positions (rounded to 1e-9), to compare meshes whose vertices
+// or triangles are numbered differently, and whose intersection points may differ by rounding errors.
+//
+static std::vector<std::array<Slicer::Vector, 3>> geometry(const std::vector<Slicer::Vector>& positions, const std::vector<Slicer::Triangle>& triangles)
+{
+    std::vector<std::array<Slicer::Vector, 3>> result;
+    for (const Slicer::Triangle& t : triangles)
+    {
+        std::array<Slicer::Vector, 3> g = {{ positions[t[0]], positions[t[1]], positions[t[2]] }};
+        for (Slicer::Vector& p : g) for (double& x : p) x = std::round(x * 1e9) / 1e9;
+        std::sort(g.begin(), g.end());
+        result.push_back(g);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static bool same(const Slicer& a, const Slicer& b)
+{
+    return a.positions == b.positions && a.triangles == b.triangles;
+}
+
+//
+// Cut the mesh by plane in every way that gives a whole mesh, and compare the results with cut.
+//
+static void check_plane(const Slicer& base, const Slicer::Plane& plane, const std::string& name, const std::string& file)
+{
+    Slicer reference = base;
+    reference.origin = plane.origin;
+    reference.normal = plane.normal;
+    reference.cut();
+    check(reference.triangles.size() > base.triangles.size(), name + ": cut splits the mesh");
+
+    Slicer parallel = base;
+    parallel.origin = plane.origin;
+    parallel.normal = plane.normal;
+    parallel.cut_parallel(2);
+    check(same(parallel, reference), name + ": cut_parallel");
+
+    Slicer delta_cut = base;
+    Slicer::Delta delta;
+    base.cut(plane, delta);
+    check(delta_cut.apply(delta) && same(delta_cut, reference), name + ": cut(plane, delta)");
+
+    Slicer indexed = base;
+    indexed.build_index();
+    indexed.cut(plane, delta);
+    check(indexed.apply(delta) && same(indexed, reference), name + ": indexed cut(plane, delta)");
+
+    Slicer swept = base;
+    Slicer::Sweep sweep;
+    Slicer::Plane before = plane;
+    for (int a = 0 ; a < 3 ; a++) before.origin[a] -= 0.01 * plane.normal[a];
+    base.recut(before, sweep);
+    base.recut(plane, sweep);
+    check(swept.apply(sweep.delta) && same(swept, reference), name + ": recut");
+
+    Slicer scratch;
+    Slicer::MeshView<double, int> view = { base.positions[0].data(), base.positions.size(), base.triangles[0].data(), base.triangles.size() };
+    Slicer::MeshOutput<double, int> output;
+    scratch.cut(view, plane, output);
+    std::vector<Slicer::Vector> positions = base.positions;
+    for (size_t k = 0 ; k < output.positions.size() ; k += 3) positions.push_back({{ output.positions[k], output.positions[k+1], output.positions[k+2] }});
+    std::vector<Slicer::Triangle> triangles(output.indices.size() / 3);
+    for (size_t t = 0 ; t < triangles.size() ; t++) triangles[t] = {{ output.indices[3*t], output.indices[3*t+1], output.indices[3*t+2] }};
+    check(positions == reference.positions && triangles == reference.triangles, name + ": cut(view, plane, output)");
+
+    Slicer batch = base;
+    batch.planes = { plane, plane };
+    for (int a = 0 ; a < 3 ; a++) batch.planes[1].origin[a] += 0.1 * plane.normal[a];
+    Slicer sequential = reference;
+    sequential.origin = batch.planes[1].origin;
+    sequential.cut();
+    batch.cut_batch();
+    check(geometry(batch.positions, batch.triangles) == geometry(sequential.positions, sequential.triangles), name + ": cut_batch");
+
+    Slicer streamed = base;
+    streamed.origin = plane.origin;
+    streamed.normal = plane.normal;
+    const std::string out = "test_output.obj";
+    Slicer loaded;
+    check(streamed.cut_stream(file, out) && loaded.load(out)
+       && geometry(loaded.positions, loaded.triangles) == geometry(reference.positions, reference.triangles), name + ": cut_stream");
+    std::remove(out.c_str());
+
+    Slicer contour = base;
+    contour.origin = plane.origin;
+    contour.normal = plane.normal;
+    std::vector<Slicer::Contour> contours, streamed_contours;
+    contour.contours(contours);
+    check(contours.size() == 1 && !contours[0].points.empty(), name + ": contours");
+    check(contour.contours_stream(file, streamed_contours) && streamed_contours.size() == 1
+       && streamed_contours[0].points == contours[0].points && streamed_contours[0].loops == contours[0].loops, name + ": contours_stream");
+}
+
+//
+// Cut with the edge table after deltas of the same size were applied and reverted, and streamed.
+//
+static void check_edge_table(const Slicer& base, const std::string& file)
+{
+    Slicer::Plane first = { {{ 0.01, 0.02, 0.03 }}, {{ 1, 0.1, 0.2 }} }, second = first;
+    second.origin[0] = 0.02;
+    Slicer::Delta a, b;
+    base.cut(first, a);
+    base.cut(second, b);
+    check(a.appended.size() == b.appended.size(), "edge table: deltas of the same size");
+
+    Slicer reference = base;
+    reference.apply(b);
+    reference.origin = {{ 0, 0.05, 0 }};
+    reference.normal = {{ 0, 1, 0 }};
+    reference.cut();
+
+    // The first cut builds the table without splitting anything.
+    Slicer edges = base;
+    edges.edge_indexed = true;
+    edges.apply(a);
+    edges.origin = {{ 0, 100, 0 }};
+    edges.normal = {{ 0, 1, 0 }};
+    edges.cut();
+    check(edges.revert(a) && edges.apply(b), "edge table: revert and apply");
+    edges.origin = reference.origin;
+    edges.cut();
+    check(same(edges, reference), "edge table: cut after revert and apply");
+
+    Slicer plain = base, streamed = base;
+    plain.origin = streamed.origin = reference.origin;
+    plain.normal = streamed.normal = reference.normal;
+    plain.cut();
+    streamed.edge_indexed = true;
+    const std::string out = "test_output.obj";
+    Slicer loaded;
+    check(streamed.cut_stream(file, out) && loaded.load(out)
+       && geometry(loaded.positions, loaded.triangles) == geometry(plain.positions, plain.triangles), "edge table: cut_stream");
+    std::remove(out.c_str());
+}
+
+//
+// Count the lookups of a cut made after stream cuts with the same Slicer.
+//
+static void check_stats(const Slicer& base, const std::string& file)
+{
+    Slicer slicer;
+    Slicer::Stats stats;
+    slicer.stats = &stats;
+    slicer.origin = {{ 0, 0.05, 0 }};
+    slicer.normal = {{ 0, 1, 0 }};
+    const std::string out = "test_output.obj";
+    check(slicer.cut_stream(file, out) && slicer.cut_pipelined(file, out), "stats: stream cuts");
+    std::remove(out.c_str());
+
+    slicer.positions = base.positions;
+    slicer.triangles = base.triangles;
+    slicer.cut();
+    check(stats.misses == slicer.positions.size() - base.positions.size() && stats.hits > 0
+       && stats.retries < stats.splits, "stats: cut after stream cuts");
+}
+
+//
+// Save a delta of the reordered mesh, and apply it to the mesh in its original order.
+//
+static void check_reordered_delta(const Slicer& base, const Slicer::Plane& plane)
+{
+    Slicer reference = base;
+    reference.origin = plane.origin;
+    reference.normal = plane.normal;
+    reference.cut();
+
+    Slicer reordered = base;
+    reordered.reorder();
+    Slicer::Delta delta, loaded;
+    reordered.cut(plane, delta);
+    const std::string out = "test_output.mmsd";
+    Slicer applied = base;
+    check(reordered.save_delta(out, delta) && Slicer::load_delta(out, loaded) && applied.apply(loaded)
+       && geometry(applied.positions, applied.triangles) == geometry(reference.positions, reference.triangles), "save_delta after reorder");
+    std::remove(out.c_str());
+}
+
+//
+// Triangles of mesh whose vertices are all vertices of base, in order, as lists of vertex positions.
+// The cut changes the other triangles, and may number its new vertices differently after reorder.
+//
+static std::vector<std::array<Slicer::Vector, 3>> kept(const Slicer& mesh, const Slicer& base)
+{
+    std::set<Slicer::Vector> original(base.positions.begin(), base.positions.end());
+    std::vector<std::array<Slicer::Vector, 3>> result;
+    for (const Slicer::Triangle& t : mesh.triangles)
+    {
+        std::array<Slicer::Vector, 3> g = {{ mesh.positions[t[0]], mesh.positions[t[1]], mesh.positions[t[2]] }};
+        if (original.count(g[0]) && original.count(g[1]) && original.count(g[2])) result.push_back(g);
+    }
+    return result;
+}
+
+//
+// Save the halves of the reordered mesh, which must be the halves of the mesh in its original order.
+//
+static void check_reordered_halves(const Slicer& base, const Slicer::Plane& plane)
+{
+    const std::string names[2][2] = { { "test_above.obj", "test_below.obj" }, { "test_reordered_above.obj", "test_reordered_below.obj" } };
+    Slicer halves[2][2];
+    bool ok = true;
+    for (int r = 0 ; r < 2 ; r++)
+    {
+        Slicer slicer = base;
+        if (r) slicer.reorder();
+        slicer.origin = plane.origin;
+        slicer.normal = plane.normal;
+        slicer.cut();
+        ok = ok && slicer.save_halves(names[r][0], names[r][1]);
+        for (int h = 0 ; h < 2 ; h++)
+        {
+            ok = ok && halves[r][h].load(names[r][h]);
+            std::remove(names[r][h].c_str());
+        }
+    }
+    for (int h = 0 ; h < 2 ; h++)
+    {
+        const Slicer& a = halves[0][h];
+        const Slicer& b = halves[1][h];
+        ok = ok && geometry(a.positions, a.triangles) == geometry(b.positions, b.triangles) && kept(a, base) == kept(b, base);
+    }
+    check(ok, "save_halves after reorder");
+}
+
+//
+// Read a plane file, which must be rejected if ok is false.
+//
+static void check_json(const std::string& text, bool ok, const std::string& name)
+{
+    const std::string out = "test_planes.json";
+    std::ofstream(out) << text;
+    Slicer slicer;
+    check(slicer.read_json(out) == ok, name);
+    std::remove(out.c_str());
+}
+
+//
+// Save the mesh as a binary file, change its bytes with edit, and check that load_binary rejects it.
+//
+template<typename Edit>
+static void check_corrupt_binary(Slicer base, Edit edit, const std::string& name)
+{
+    const std::string out = "test_output.mmsb";
+    base.save_binary(out);
+    std::string bytes;
+    {
+        std::ifstream in(out, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    edit(bytes);
+    std::ofstream(out, std::ios::binary) << bytes;
+    Slicer loaded;
+    check(!loaded.load_binary(out) && loaded.positions.empty() && loaded.triangles.empty(), name);
+    std::remove(out.c_str());
+}
+
+//
+// Save delta as a binary file, change its bytes with edit, and check that load_delta rejects it.
+//
+template<typename Edit>
+static void check_corrupt_delta(const Slicer& base, const Slicer::Delta& delta, Edit edit, const std::string& name)
+{
+    const std::string out = "test_output.mmsd";
+    base.save_delta(out, delta);
+    std::string bytes;
+    {
+        std::ifstream in(out, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    edit(bytes);
+    std::ofstream(out, std::ios::binary) << bytes;
+    Slicer::Delta loaded;
+    check(!Slicer::load_delta(out, loaded) && loaded.vertices.empty() && loaded.replaced.empty() && loaded.appended.empty(), name);
+    std::remove(out.c_str());
+}
+
+
+int main(int argc, char *argv[])
+{
+    const std::string file = argc > 1 ? argv[1] : "torus.obj";
+    Slicer base;
+    if (!base.load(file))
+    {
+        std::cerr << "Could not read file " << file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    check_plane(base, { {{ 0.01, 0.02, 0.03 }}, {{ 0.1, 1, 0.2 }} }, "tilted plane", file);
+
+    // A plane through the origin is cut like any other plane.
+    check_plane(base, { {{ 0, 0, 0 }}, {{ 0.1, 1, 0.2 }} }, "plane through the origin", file);
+    check_plane(base, { {{ 0, 0, 0 }}, {{ 1, 0.3, 0 }} },   "other plane through the origin", file);
+
+    check_edge_table(base, file);
+    check_stats(base, file);
+    check_reordered_delta(base, { {{ 0.01, 0.02, 0.03 }}, {{ 0.1, 1, 0.2 }} });
+    check_reordered_halves(base, { {{ 0.01, 0.02, 0.03 }}, {{ 0.1, 1, 0.2 }} });
+
+    check_json("{ \"origin\": [0, -0.3, 0], \"normal\": [0, 1, 0], \"spacing\": 0.02, \"count\": 30 }", true, "stack of planes");
+    check_json("{ \"origin\": [0, -0.3, 0], \"normal\": [0, 1, 0], \"spacing\": 0.02, \"count\": -5 }", false, "negative count");
+    check_json("{ \"origin\": [0, -0.3, 0], \"normal\": [0, 1, 0], \"spacing\": 0.02, \"count\": 1e12 }", false, "huge count");
+    check_json("{ \"origin\": [0, -0.3, 0], \"normal\": [0, 1, 0], \"spacing\": 0.02, \"count\": 2.5 }", false, "fractional count");
+    check_json("{ \"planes\": [ { \"origin\": [0, 0, 0], \"normal\": [0, 1, 0] }, { \"origin\": [0, 0.1, 0] } ] }", false, "missing normal");
+    check_json("{ \"origin\": [0, 0, 0], \"normal\": [0, 1, 0], \"metadata\": { \"origin\": [1, 2, 3] } }", true, "nested origin in metadata");
+    check_json("{ \"planes\": [ { \"origin\": [0, 0, 0], \"normal\": [0, 1, 0], \"source\": { \"normal\": [1, 0, 0], \"count\": 0 } } ] }", true, "nested keys in a plane");
+
+    // The header is 32 bytes, with the vertex count at offset 16 and the triangle count at offset 24.
+    const size_t vertex_count = 16, triangle_count = 24, first_index = 32 + base.positions.size() * sizeof(Slicer::Vector);
+    check_corrupt_binary(base, [&](std::string& b) { b.resize(b.size() - 1); }, "truncated binary mesh");
+    // Counts whose byte sizes wrap around to the right file size.
+    check_corrupt_binary(base, [&](std::string& b) { uint64_t n = base.positions.size() + (uint64_t(1) << 61); std::memcpy(&b[vertex_count], &n, 8); }, "binary vertex count overflow");
+    check_corrupt_binary(base, [&](std::string& b) { uint64_t n = base.triangles.size() + (uint64_t(1) << 62); std::memcpy(&b[triangle_count], &n, 8); }, "binary triangle count overflow");
+    check_corrupt_binary(base, [&](std::string& b) { int v = int(base.positions.size()); std::memcpy(&b[first_index], &v, 4); }, "binary index out of range");
+    check_corrupt_binary(base, [&](std::string& b) { int v = -1; std::memcpy(&b[first_index], &v, 4); }, "negative binary index");
+
+    // The delta header is 56 bytes, with the vertex, replaced and appended counts at offsets 32, 40 and 48,
+    // followed by the vertices, replaced, original, changed and appended arrays.
+    Slicer::Delta delta;
+    base.cut({ {{ 0.01, 0.02, 0.03 }}, {{ 0.1, 1, 0.2 }} }, delta);
+    const size_t new_vertices = 32, replaced_count = 40, appended_count = 48, first_replaced = 56 + delta.vertices.size() * sizeof(Slicer::Vector);
+    const int cut_vertices = int(base.positions.size() + delta.vertices.size());
+    check_corrupt_delta(base, delta, [&](std::string& b) { b.resize(b.size() - 1); }, "truncated delta");
+    // Counts whose byte sizes wrap around to the right file size.
+    check_corrupt_delta(base, delta, [&](std::string& b) { uint64_t n = delta.vertices.size() + (uint64_t(1) << 61); std::memcpy(&b[new_vertices], &n, 8); }, "delta vertex count overflow");
+    check_corrupt_delta(base, delta, [&](std::string& b) { uint64_t n = delta.replaced.size() + (uint64_t(1) << 62); std::memcpy(&b[replaced_count], &n, 8); }, "delta replaced count overflow");
+    check_corrupt_delta(base, delta, [&](std::string& b) { uint64_t n = delta.appended.size() + (uint64_t(1) << 62); std::memcpy(&b[appended_count], &n, 8); }, "delta appended count overflow");
+    check_corrupt_delta(base, delta, [&](std::string& b) { int t = int(base.triangles.size()); std::memcpy(&b[first_replaced], &t, 4); }, "delta replaced triangle out of range");
+    check_corrupt_delta(base, delta, [&](std::string& b) { std::memcpy(&b[first_replaced + 4], &b[first_replaced], 4); }, "delta replaced triangles out of order");
+    check_corrupt_delta(base, delta, [&](std::string& b) { std::memcpy(&b[b.size() - 4], &cut_vertices, 4); }, "delta index out of range");
+
+    std::cout << (failures ? "Some checks failed" : "All checks passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}